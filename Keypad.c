@@ -74,6 +74,10 @@
 *******************************************************************************/
 void Keypad_busEnable()
 {
+#if LCD_ASYNC == ENABLE
+    while (!LCD_idle())    // LCD_ISR must be done with the shared pins
+        NOP();
+#endif
     // This is for 4x4 Matrix keypad. Customize this code for any other size
     KP_COL1     = 1;
     KP_COL2     = 1;
@@ -132,26 +136,21 @@ void LCD_busEnable()
     KP_ROW3     = 1;
     KP_ROW4     = 1;
 
-    LCD_4 = 1;          // Data bus = 0
-    LCD_5 = 1;
-    LCD_6 = 1;
-    LCD_7 = 1;
+    LCD_DATA_PORT |= LCD_DATA_MASK;     // Data bus = 1
 
     LCD_RS_dir  = OUTPUT;     // Set as Output
     LCD_E_dir   = OUTPUT;
 
-    LCD_4_dir   = OUTPUT;
-    LCD_5_dir   = OUTPUT;
-    LCD_6_dir   = OUTPUT;
-    LCD_7_dir   = OUTPUT;
+    LCD_DATA_TRIS &= ~LCD_DATA_MASK;
 
     LCD_RS = 1;         // RS  = 0
     LCD_E = 0;          // E  = 0
+#if LCD_RW_PIN == ENABLE
+    LCD_RW_dir = OUTPUT;
+    LCD_RW = 0;         // Write, the LCD must not drive the shared bus
+#endif
 
-    LCD_4 = 1;          // Data bus = 0
-    LCD_5 = 1;
-    LCD_6 = 1;
-    LCD_7 = 1;
+    LCD_DATA_PORT |= LCD_DATA_MASK;
 }
 
 /*******************************************************************************
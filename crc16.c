@@ -0,0 +1,37 @@
+/*
+ * File:   crc16.c
+ *
+ * Created on 17 October 2026
+ */
+
+// include the header for CRC library:
+#include "crc16.h"
+
+
+/*******************************************************************************
+* This file provides the CRC-16 used by the serial protocol layers
+*******************************************************************************/
+
+// CRC of each 4-bit value. Two lookups per byte instead of eight shift/xor
+// steps, for 32 bytes of program memory.
+const unsigned int crc16_table[16] = {
+    0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+    0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+// Adds one byte to a running CRC and returns the new CRC
+unsigned int CRC16_update(unsigned int crc, unsigned char data)
+{
+    crc = (crc >> 4) ^ crc16_table[(crc ^ data) & 0x0F];
+    crc = (crc >> 4) ^ crc16_table[(crc ^ (data >> 4)) & 0x0F];
+    return crc;
+}
+
+// CRC of a whole block, starting from CRC16_INIT
+unsigned int CRC16_block(const unsigned char *data, unsigned char length)
+{
+    unsigned int crc = CRC16_INIT;
+    while (length--)
+        crc = CRC16_update(crc, *data++);
+    return crc;
+}
@@ -0,0 +1,30 @@
+/*
+ * File:   crc16.h
+ *
+ * Created on 17 October 2026
+ */
+
+#ifndef CRC16_H
+#define	CRC16_H
+
+#include "system.h"
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+// CRC-16/MODBUS: polynomial 0x8005(reflected 0xA001), initial value 0xFFFF.
+// Sent low byte first, the CRC over data and CRC is CRC16_OK.
+#define CRC16_INIT      0xFFFF
+#define CRC16_OK        0x0000
+
+
+/*******************************************************************************
+* FUNCTION PROTOTYPES                                                          *
+*******************************************************************************/
+// Adds one byte to a running CRC and returns the new CRC
+unsigned int CRC16_update(unsigned int crc, unsigned char data);
+
+// CRC of a whole block, starting from CRC16_INIT
+unsigned int CRC16_block(const unsigned char *data, unsigned char length);
+
+#endif	/* CRC16_H */
@@ -0,0 +1,178 @@
+/*
+ * File:   bench.c
+ *
+ * Created on 17 October 2026
+ */
+
+/*******************************************************************************
+* Throughput benchmark of the library on the host model(pic16f887.c).
+*
+* Rates come from the model's instruction cycles(Fosc/4 at _XTAL_FREQ): the
+* delays, the UART character times and one cycle per status poll, Timer1 read
+* or NOP(). The cost of the C code itself is not modelled, so the ISR time is
+* host time: compare it between two builds on the same machine, use ISR_TIMING
+* in serial.h for the cycles on the PIC.
+*
+* Each result is one line "name value unit", to diff against a baseline.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../serial.h"
+#include "../lcd.h"
+
+// Keypad.h defines the keymap, so it is included by Keypad.c only
+void Keypad_begin(unsigned char Keypad_ISR_Enable);
+unsigned char Keypad_ISR(void);
+unsigned char Keypad_getKey(void);
+
+#define BENCH_BAUD          115200
+#define BENCH_LINES         64
+#define BENCH_BYTES         4096
+#define BENCH_LCD_LOOPS     64
+
+static unsigned long long read_ns = 0;      // Host time in Serial_ReadISR
+static unsigned long long write_ns = 0;     // Host time in Serial_WriteISR
+static unsigned char keypad_isr = 0;
+static unsigned char key = 0;
+static unsigned long long key_cycles;       // Cycle count when Keypad_ISR returned
+static unsigned char rx_data[BENCH_BYTES];
+
+static unsigned long long host_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static double per_second(unsigned long count, unsigned long long cycles)
+{
+    return cycles ? (double)count * (_XTAL_FREQ / 4) / cycles : 0;
+}
+
+static double to_us(unsigned long long cycles)
+{
+    return (double)cycles * 4000000.0 / _XTAL_FREQ;
+}
+
+// The interrupt function, as in main.c
+void host_isr(void)
+{
+    unsigned long long start;
+
+    if (RBIE && RBIF && keypad_isr)
+    {
+        key = Keypad_ISR();
+        key_cycles = host_cycles();
+    }
+    if (RCIE && RCIF)
+    {
+        start = host_ns();
+        Serial_ReadISR();
+        read_ns += host_ns() - start;
+    }
+    if (TXIE && TXIF)
+    {
+        start = host_ns();
+        Serial_WriteISR();
+        write_ns += host_ns() - start;
+    }
+}
+
+static void bench_serial_tx(void)
+{
+    static unsigned char line[] = "The quick brown fox jumps over the lazy dog 0123456789";
+    unsigned long long start = host_cycles();
+    unsigned long sent = host_sent();
+    unsigned int i;
+
+    // Lines longer than the outgoing buffer, so Serial_write waits for room
+    for (i = 0; i < BENCH_LINES; i++)
+        Serial_println(line);
+    Serial_flush();
+    sent = host_sent() - sent;
+    printf("serial_tx_rate %.0f bytes/s\n", per_second(sent, host_cycles() - start));
+    printf("serial_tx_isr %.1f ns/byte\n", sent ? (double)write_ns / sent : 0);
+}
+
+static void bench_serial_rx(void)
+{
+    unsigned char buffer[64];
+    unsigned long long start;
+    unsigned long long end;
+    unsigned int count = 0;
+    unsigned int errors = 0;
+    unsigned char length;
+    unsigned int i;
+
+    for (i = 0; i < BENCH_BYTES; i++)
+        rx_data[i] = (unsigned char)(i * 7);
+    start = host_cycles();
+    end = start;
+    host_receive(rx_data, BENCH_BYTES);
+    // Ends with the time-out once the data stops
+    while ((length = Serial_readBytes(buffer, sizeof(buffer))) != 0)
+    {
+        for (i = 0; i < length && count < BENCH_BYTES; i++, count++)
+            if (buffer[i] != rx_data[count])
+                errors++;
+        end = host_cycles();
+    }
+    printf("serial_rx_rate %.0f bytes/s\n", per_second(count, end - start));
+    printf("serial_rx_isr %.1f ns/byte\n", count ? (double)read_ns / count : 0);
+    printf("serial_rx_lost %u bytes\n", Serial_dropCount() + errors);
+}
+
+static void bench_lcd(void)
+{
+    static unsigned char text[] = "0123456789ABCDEF";
+    unsigned long long start;
+    unsigned int i;
+
+    LCD_begin();
+    start = host_cycles();
+    for (i = 0; i < BENCH_LCD_LOOPS; i++)
+        LCD_print(1, 1, text);
+    printf("lcd_rate %.0f chars/s\n",
+           per_second(BENCH_LCD_LOOPS * (sizeof(text) - 1), host_cycles() - start));
+}
+
+static void bench_keypad(void)
+{
+    unsigned long long start;
+
+    // Interrupt on change: Keypad_ISR is called from host_isr
+    keypad_isr = 1;
+    Keypad_begin(1);
+    key = 0;
+    start = host_cycles();
+    host_key(2, 3);
+    host_run(0);
+    printf("key_isr_latency %.1f us (key %c)\n", to_us(key_cycles - start), key ? key : '-');
+    host_key(0, 0);
+    host_run(0);
+
+    // Polled by the main loop
+    keypad_isr = 0;
+    RBIE = 0;
+    Keypad_begin(0);
+    host_key(4, 1);
+    start = host_cycles();
+    key = Keypad_getKey();
+    printf("key_poll_latency %.1f us (key %c)\n", to_us(host_cycles() - start), key ? key : '-');
+    host_key(0, 0);
+}
+
+int main(void)
+{
+    Timer_begin();
+    Serial_begin(BENCH_BAUD);
+    printf("xtal %lu Hz\n", (unsigned long)_XTAL_FREQ);
+    bench_serial_tx();
+    bench_serial_rx();
+    bench_lcd();
+    bench_keypad();
+    return 0;
+}
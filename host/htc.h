@@ -0,0 +1,108 @@
+/*
+ * File:   htc.h
+ *
+ * Created on 17 October 2026
+ */
+
+/*******************************************************************************
+* Stand-in for the HI-TECH C header, so serial.c, lcd.c, Keypad.c and system.c
+* build on a Linux host against the PIC16F887 model in pic16f887.c.
+*
+* Registers are plain variables except the ones with hardware behaviour:
+* ~ TXREG, RCREG, CREN     - the EUSART model(transmit, 2 byte receive FIFO, OERR)
+* ~ TXIF, RCIF, TRMT       - status polls, each read costs one instruction cycle
+* ~ TMR1L, TMR1H           - Timer1 reads, one instruction cycle each
+* ~ RB4..RB7               - keypad columns, read through the key matrix
+*
+* Time only moves in the delays, the register reads above, NOP() and host_run.
+* The library's loops that wait for an interrupt call NOP(), so Serial_write,
+* Serial_flush and the time-outs complete. Interrupts are taken when time
+* moves, by calling host_isr(supplied by the program, like the interrupt
+* function of main.c).
+*******************************************************************************/
+
+#ifndef HOST_HTC_H
+#define	HOST_HTC_H
+
+#define bit                 unsigned char
+#define interrupt
+#define persistent
+#define __CONFIG(x)
+#define NOP()               host_run(1)
+#define CLRWDT()
+#define di()                (GIE = 0)
+#define ei()                (GIE = 1)
+
+// Delays advance the cycle counter(Fosc/4) instead of spinning
+#define _delay(cycles)      host_run(cycles)
+#define __delay_us(x)       host_run((unsigned long)(x) * (_XTAL_FREQ / 4000000UL))
+#define __delay_ms(x)       host_run((unsigned long)(x) * (_XTAL_FREQ / 4000UL))
+
+#define HOST_REG(x)         extern volatile unsigned char x;
+
+// EUSART
+HOST_REG(TXSTA) HOST_REG(RCSTA) HOST_REG(BAUDCTL) HOST_REG(SPBRG) HOST_REG(SPBRGH)
+HOST_REG(TX9) HOST_REG(TXEN) HOST_REG(SYNC) HOST_REG(BRGH) HOST_REG(TX9D)
+HOST_REG(SPEN) HOST_REG(RX9) HOST_REG(ADDEN) HOST_REG(FERR) HOST_REG(OERR) HOST_REG(RX9D)
+HOST_REG(SCKP) HOST_REG(BRG16) HOST_REG(WUE) HOST_REG(ABDEN) HOST_REG(ABDOVF) HOST_REG(RCIDL)
+// Interrupts
+HOST_REG(INTCON) HOST_REG(PIR1) HOST_REG(PIE1) HOST_REG(GIE) HOST_REG(PEIE)
+HOST_REG(TXIE) HOST_REG(RCIE) HOST_REG(RBIE) HOST_REG(RBIF)
+// Timers and CCP
+HOST_REG(OPTION_REG) HOST_REG(T0CS) HOST_REG(PSA) HOST_REG(PS0) HOST_REG(PS1) HOST_REG(PS2)
+HOST_REG(TMR0) HOST_REG(T0IE) HOST_REG(T0IF) HOST_REG(TMR0IE) HOST_REG(TMR0IF)
+HOST_REG(T1CON) HOST_REG(TMR1ON) HOST_REG(TMR1CS) HOST_REG(TMR1GE) HOST_REG(T1CKPS0) HOST_REG(T1CKPS1)
+HOST_REG(TMR1IE) HOST_REG(TMR1IF)
+HOST_REG(T2CON) HOST_REG(TMR2) HOST_REG(PR2) HOST_REG(TMR2ON) HOST_REG(TMR2IE) HOST_REG(TMR2IF)
+HOST_REG(CCP1CON) HOST_REG(CCPR1H) HOST_REG(CCPR1L) HOST_REG(CCP1IE) HOST_REG(CCP1IF)
+HOST_REG(CCP2CON) HOST_REG(CCPR2H) HOST_REG(CCPR2L) HOST_REG(CCP2IE) HOST_REG(CCP2IF)
+// Ports
+HOST_REG(PORTA) HOST_REG(PORTB) HOST_REG(PORTC) HOST_REG(PORTD)
+HOST_REG(TRISA) HOST_REG(TRISB) HOST_REG(TRISC) HOST_REG(TRISD)
+HOST_REG(RA0) HOST_REG(RA1) HOST_REG(RA2) HOST_REG(RA3)
+HOST_REG(RB0) HOST_REG(RB1) HOST_REG(RB2) HOST_REG(RB3)
+HOST_REG(RC0) HOST_REG(RC1) HOST_REG(RC2) HOST_REG(RC3) HOST_REG(RC4) HOST_REG(RC5) HOST_REG(RC6) HOST_REG(RC7)
+HOST_REG(RD0) HOST_REG(RD1) HOST_REG(RD2) HOST_REG(RD3) HOST_REG(RD4) HOST_REG(RD5)
+HOST_REG(TRISA0) HOST_REG(TRISA1) HOST_REG(TRISA2) HOST_REG(TRISA3)
+HOST_REG(TRISB0) HOST_REG(TRISB1) HOST_REG(TRISB2) HOST_REG(TRISB3)
+HOST_REG(TRISB4) HOST_REG(TRISB5) HOST_REG(TRISB6) HOST_REG(TRISB7)
+HOST_REG(TRISC0) HOST_REG(TRISC1) HOST_REG(TRISC2) HOST_REG(TRISC3) HOST_REG(TRISC4) HOST_REG(TRISC5)
+HOST_REG(TRISD0) HOST_REG(TRISD1) HOST_REG(TRISD2) HOST_REG(TRISD3)
+HOST_REG(ANSEL) HOST_REG(ANSELH) HOST_REG(WPUB) HOST_REG(nRBPU)
+HOST_REG(IOCB) HOST_REG(IOCB4) HOST_REG(IOCB5) HOST_REG(IOCB6) HOST_REG(IOCB7)
+// Oscillator
+HOST_REG(OSCCON) HOST_REG(SCS)
+
+// Registers with hardware behaviour
+#define TXREG               (*host_txreg())
+#define RCREG               host_rcreg()
+#define CREN                (*host_cren())
+#define TXIF                (*host_poll(&host_txif))
+#define RCIF                (*host_poll(&host_rcif))
+#define TRMT                (*host_poll(&host_trmt))
+#define TMR1L               (*host_timer1(0))
+#define TMR1H               (*host_timer1(1))
+#define RB4                 (*host_column(0))
+#define RB5                 (*host_column(1))
+#define RB6                 (*host_column(2))
+#define RB7                 (*host_column(3))
+
+extern volatile unsigned char host_txif, host_rcif, host_trmt;
+volatile unsigned char *host_txreg(void);
+unsigned char host_rcreg(void);
+volatile unsigned char *host_cren(void);
+volatile unsigned char *host_poll(volatile unsigned char *flag);
+volatile unsigned char *host_column(unsigned char col);
+volatile unsigned char *host_timer1(unsigned char high);
+
+// Model control, for the program driving the library
+void host_isr(void);                                // Supplied by the program
+void host_run(unsigned long cycles);                // Let time pass, take interrupts
+unsigned long long host_cycles(void);               // Instruction cycles since start
+void host_receive(const unsigned char *data, unsigned int length);  // Line input
+unsigned long host_rx_pending(void);                // Bytes still to arrive
+unsigned long host_sent(void);                      // Bytes shifted out by TXREG
+unsigned char host_tx_idle(void);                   // TXREG and shift register empty
+void host_key(unsigned char row, unsigned char col);    // Press(1..4), 0 to release
+
+#endif	/* HOST_HTC_H */
@@ -0,0 +1,325 @@
+/*
+ * File:   pic16f887.c
+ *
+ * Created on 17 October 2026
+ */
+
+/*******************************************************************************
+* Host model of the PIC16F887 peripherals used by the library(see htc.h).
+*
+* ~ Cycle counter   - instruction cycles(Fosc/4), moved by host_run
+* ~ Timer1          - TMR1H:TMR1L read the cycle counter while T1CON<0> is set
+* ~ EUSART          - TXREG and the shift register send one character per
+*                     10(11 with TX9) bit times of SPBRGH:SPBRG, BRGH and BRG16.
+*                     Input from host_receive arrives back to back into the
+*                     2 byte FIFO; a third byte sets OERR and is lost.
+* ~ Keypad          - a pressed key connects its row(RB0..RB3) to its column
+*                     (RB4..RB7, pulled up); a column change sets RBIF if its
+*                     IOCB bit is set.
+*******************************************************************************/
+
+#include <htc.h>
+
+#define HOST_REG_DEF(x)     volatile unsigned char x;
+
+HOST_REG_DEF(TXSTA) HOST_REG_DEF(RCSTA) HOST_REG_DEF(BAUDCTL) HOST_REG_DEF(SPBRG) HOST_REG_DEF(SPBRGH)
+HOST_REG_DEF(TX9) HOST_REG_DEF(TXEN) HOST_REG_DEF(SYNC) HOST_REG_DEF(BRGH) HOST_REG_DEF(TX9D)
+HOST_REG_DEF(SPEN) HOST_REG_DEF(RX9) HOST_REG_DEF(ADDEN) HOST_REG_DEF(FERR) HOST_REG_DEF(OERR) HOST_REG_DEF(RX9D)
+HOST_REG_DEF(SCKP) HOST_REG_DEF(BRG16) HOST_REG_DEF(WUE) HOST_REG_DEF(ABDEN) HOST_REG_DEF(ABDOVF) HOST_REG_DEF(RCIDL)
+HOST_REG_DEF(INTCON) HOST_REG_DEF(PIR1) HOST_REG_DEF(PIE1) HOST_REG_DEF(GIE) HOST_REG_DEF(PEIE)
+HOST_REG_DEF(TXIE) HOST_REG_DEF(RCIE) HOST_REG_DEF(RBIE) HOST_REG_DEF(RBIF)
+HOST_REG_DEF(OPTION_REG) HOST_REG_DEF(T0CS) HOST_REG_DEF(PSA) HOST_REG_DEF(PS0) HOST_REG_DEF(PS1) HOST_REG_DEF(PS2)
+HOST_REG_DEF(TMR0) HOST_REG_DEF(T0IE) HOST_REG_DEF(T0IF) HOST_REG_DEF(TMR0IE) HOST_REG_DEF(TMR0IF)
+HOST_REG_DEF(T1CON) HOST_REG_DEF(TMR1ON) HOST_REG_DEF(TMR1CS) HOST_REG_DEF(TMR1GE) HOST_REG_DEF(T1CKPS0) HOST_REG_DEF(T1CKPS1)
+HOST_REG_DEF(TMR1IE) HOST_REG_DEF(TMR1IF)
+HOST_REG_DEF(T2CON) HOST_REG_DEF(TMR2) HOST_REG_DEF(PR2) HOST_REG_DEF(TMR2ON) HOST_REG_DEF(TMR2IE) HOST_REG_DEF(TMR2IF)
+HOST_REG_DEF(CCP1CON) HOST_REG_DEF(CCPR1H) HOST_REG_DEF(CCPR1L) HOST_REG_DEF(CCP1IE) HOST_REG_DEF(CCP1IF)
+HOST_REG_DEF(CCP2CON) HOST_REG_DEF(CCPR2H) HOST_REG_DEF(CCPR2L) HOST_REG_DEF(CCP2IE) HOST_REG_DEF(CCP2IF)
+HOST_REG_DEF(PORTA) HOST_REG_DEF(PORTB) HOST_REG_DEF(PORTC) HOST_REG_DEF(PORTD)
+HOST_REG_DEF(TRISA) HOST_REG_DEF(TRISB) HOST_REG_DEF(TRISC) HOST_REG_DEF(TRISD)
+HOST_REG_DEF(RA0) HOST_REG_DEF(RA1) HOST_REG_DEF(RA2) HOST_REG_DEF(RA3)
+HOST_REG_DEF(RB0) HOST_REG_DEF(RB1) HOST_REG_DEF(RB2) HOST_REG_DEF(RB3)
+HOST_REG_DEF(RC0) HOST_REG_DEF(RC1) HOST_REG_DEF(RC2) HOST_REG_DEF(RC3) HOST_REG_DEF(RC4) HOST_REG_DEF(RC5) HOST_REG_DEF(RC6) HOST_REG_DEF(RC7)
+HOST_REG_DEF(RD0) HOST_REG_DEF(RD1) HOST_REG_DEF(RD2) HOST_REG_DEF(RD3) HOST_REG_DEF(RD4) HOST_REG_DEF(RD5)
+HOST_REG_DEF(TRISA0) HOST_REG_DEF(TRISA1) HOST_REG_DEF(TRISA2) HOST_REG_DEF(TRISA3)
+HOST_REG_DEF(TRISB0) HOST_REG_DEF(TRISB1) HOST_REG_DEF(TRISB2) HOST_REG_DEF(TRISB3)
+HOST_REG_DEF(TRISB4) HOST_REG_DEF(TRISB5) HOST_REG_DEF(TRISB6) HOST_REG_DEF(TRISB7)
+HOST_REG_DEF(TRISC0) HOST_REG_DEF(TRISC1) HOST_REG_DEF(TRISC2) HOST_REG_DEF(TRISC3) HOST_REG_DEF(TRISC4) HOST_REG_DEF(TRISC5)
+HOST_REG_DEF(TRISD0) HOST_REG_DEF(TRISD1) HOST_REG_DEF(TRISD2) HOST_REG_DEF(TRISD3)
+HOST_REG_DEF(ANSEL) HOST_REG_DEF(ANSELH) HOST_REG_DEF(WPUB) HOST_REG_DEF(nRBPU)
+HOST_REG_DEF(IOCB) HOST_REG_DEF(IOCB4) HOST_REG_DEF(IOCB5) HOST_REG_DEF(IOCB6) HOST_REG_DEF(IOCB7)
+HOST_REG_DEF(OSCCON) HOST_REG_DEF(SCS)
+
+volatile unsigned char host_txif = 1;
+volatile unsigned char host_rcif = 0;
+volatile unsigned char host_trmt = 1;
+
+static unsigned long long now = 0;          // Instruction cycles
+static unsigned char in_isr = 0;
+
+// EUSART
+static volatile unsigned char txreg;
+static volatile unsigned char cren;
+static unsigned char txreg_full = 0;        // TXREG written, not in the shift register yet
+static unsigned char tsr_busy = 0;
+static unsigned long long tsr_done;         // End of the stop bit
+static unsigned long tx_count = 0;
+static unsigned char rx_fifo[2];
+static unsigned char rx_fifo_count = 0;
+static unsigned char rx_last = 0;
+static const unsigned char *rx_data;
+static unsigned int rx_length = 0;
+static unsigned long long rx_next;          // Arrival of rx_data[0]
+
+// Keypad
+static unsigned char key_row = 0;           // 1..4, 0 for none
+static unsigned char key_col = 0;
+static volatile unsigned char column[4];
+
+static void host_events(void);
+
+/*******************************************************************************
+* PRIVATE FUNCTION: char_cycles
+*
+* RETURN:
+* ~ unsigned long       - Instruction cycles of one character at the set rate
+*
+*******************************************************************************/
+static unsigned long char_cycles(void)
+{
+    unsigned long divider;
+    unsigned long brg = SPBRG;
+
+    if (BRG16)
+    {
+        divider = BRGH ? 4 : 16;
+        brg |= (unsigned int)SPBRGH << 8;
+    }
+    else
+        divider = BRGH ? 16 : 64;
+    // Bit time in Fosc cycles is divider * (brg + 1), 4 Fosc cycles per instruction
+    return (TX9 ? 11 : 10) * divider * (brg + 1) / 4;
+}
+
+/*******************************************************************************
+* PRIVATE FUNCTION: column_level
+*
+* RETURN:
+* ~ unsigned char       - Level of a keypad column(0..3) with the current rows
+*
+*******************************************************************************/
+static unsigned char column_level(unsigned char col)
+{
+    static volatile unsigned char *const rows[4] = {&RB0, &RB1, &RB2, &RB3};
+
+    if (key_row && key_col == col + 1 && *rows[key_row - 1] == 0)
+        return 0;
+    return 1;                                   // Pulled up
+}
+
+/*******************************************************************************
+* PRIVATE FUNCTION: interrupt_pending
+*
+*******************************************************************************/
+static unsigned char interrupt_pending(void)
+{
+    if (!GIE)
+        return 0;
+    if ((RBIE && RBIF) || ((T0IE || TMR0IE) && (T0IF || TMR0IF)))
+        return 1;
+    return PEIE && ((RCIE && host_rcif) || (TXIE && host_txif)
+                    || (CCP1IE && CCP1IF) || (CCP2IE && CCP2IF)
+                    || (TMR1IE && TMR1IF) || (TMR2IE && TMR2IF));
+}
+
+/*******************************************************************************
+* PRIVATE FUNCTION: host_events
+*
+* DESCRIPTIONS:
+* Brings the peripherals to the current cycle and takes the pending
+* interrupts. host_isr is not nested: inside it only the peripherals move.
+*
+*******************************************************************************/
+static void host_events(void)
+{
+    do
+    {
+        if (tsr_busy && now >= tsr_done)
+        {
+            tsr_busy = 0;
+            tx_count++;
+        }
+        if (txreg_full && !tsr_busy)
+        {
+            txreg_full = 0;             // TXREG moves to the shift register
+            tsr_busy = 1;
+            tsr_done = now + char_cycles();
+        }
+        host_txif = !txreg_full;
+        host_trmt = !tsr_busy;
+
+        while (rx_length && now >= rx_next)
+        {
+            if (!SPEN || !cren || OERR)
+                ;                       // Receiver off or stopped by an overrun
+            else if (rx_fifo_count == 2)
+                OERR = 1;
+            else
+                rx_fifo[rx_fifo_count++] = *rx_data;
+            rx_data++;
+            rx_length--;
+            rx_next += char_cycles();
+        }
+        host_rcif = rx_fifo_count != 0;
+
+        if (in_isr || !interrupt_pending())
+            return;
+        in_isr = 1;
+        host_isr();
+        in_isr = 0;
+    } while (1);
+}
+
+/*******************************************************************************
+* PUBLIC FUNCTION: host_run
+*
+* PARAMETERS:
+* ~ cycles              - Instruction cycles to pass
+*
+* DESCRIPTIONS:
+* Lets time pass, running the peripherals and the interrupts on the way.
+* host_run(0) only takes the interrupts that are pending now.
+*
+*******************************************************************************/
+void host_run(unsigned long cycles)
+{
+    unsigned long long end = now + cycles;
+    unsigned long long next;
+
+    host_events();
+    while (now < end)
+    {
+        next = end;
+        if (tsr_busy && tsr_done < next)
+            next = tsr_done;
+        if (rx_length && rx_next < next)
+            next = rx_next;
+        now = next;
+        host_events();
+    }
+}
+
+unsigned long long host_cycles(void)
+{
+    return now;
+}
+
+/*******************************************************************************
+* PUBLIC FUNCTION: host_receive
+*
+* PARAMETERS:
+* ~ data                - Bytes sent to RX, must stay valid until received
+* ~ length              - Number of bytes
+*
+* DESCRIPTIONS:
+* Sends bytes to the receiver back to back, the first one ending a character
+* time from now. Replaces the bytes not received yet.
+*
+*******************************************************************************/
+void host_receive(const unsigned char *data, unsigned int length)
+{
+    rx_data = data;
+    rx_length = length;
+    rx_next = now + char_cycles();
+}
+
+unsigned long host_rx_pending(void)
+{
+    return rx_length;
+}
+
+unsigned long host_sent(void)
+{
+    return tx_count;
+}
+
+unsigned char host_tx_idle(void)
+{
+    host_events();
+    return !txreg_full && !tsr_busy;
+}
+
+/*******************************************************************************
+* PUBLIC FUNCTION: host_key
+*
+* PARAMETERS:
+* ~ row                 - Row of the key(1..4), 0 to release the key
+* ~ col                 - Column of the key(1..4)
+*
+*******************************************************************************/
+void host_key(unsigned char row, unsigned char col)
+{
+    static volatile unsigned char *const ioc[4] = {&IOCB4, &IOCB5, &IOCB6, &IOCB7};
+    unsigned char before[4];
+    unsigned char i;
+
+    for (i = 0; i < 4; i++)
+        before[i] = column_level(i);
+    key_row = row;
+    key_col = row ? col : 0;
+    for (i = 0; i < 4; i++)
+        if (*ioc[i] && column_level(i) != before[i])
+            RBIF = 1;
+    host_events();
+}
+
+/*******************************************************************************
+* Register accesses(see the macros in htc.h)
+*******************************************************************************/
+volatile unsigned char *host_txreg(void)
+{
+    // The byte is written after the return: it is taken by the next event
+    txreg_full = 1;
+    host_txif = 0;
+    return &txreg;
+}
+
+unsigned char host_rcreg(void)
+{
+    if (rx_fifo_count)
+    {
+        rx_last = rx_fifo[0];
+        rx_fifo[0] = rx_fifo[1];
+        rx_fifo_count--;
+    }
+    host_rcif = rx_fifo_count != 0;
+    return rx_last;
+}
+
+volatile unsigned char *host_cren(void)
+{
+    OERR = 0;           // Clearing CREN clears OERR, the code only writes CREN
+    return &cren;
+}
+
+volatile unsigned char *host_poll(volatile unsigned char *flag)
+{
+    host_run(1);
+    return flag;
+}
+
+volatile unsigned char *host_timer1(unsigned char high)
+{
+    static volatile unsigned char value;
+
+    host_run(1);
+    value = (T1CON & 0x01) ? (unsigned char)(high ? now >> 8 : now) : 0;
+    return &value;
+}
+
+volatile unsigned char *host_column(unsigned char col)
+{
+    host_run(1);
+    column[col] = column_level(col);
+    return &column[col];
+}
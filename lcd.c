@@ -28,11 +28,19 @@
  * LCD_putchar('a')             - Print a character at current cursor postion
  * LCD_BCDprint(4,678)          - Print number 678 in 4 digit form(Output: 0678)
  * Set_LCD(0, 0x06)             - Send the command 0x06 to LCD(0=command, 1=data)
+ * LCD_refresh()                - Send the changed characters(LCD_SHADOW only)
+ * LCD_idle()                   - Check that the queue is sent(LCD_ASYNC only)
+ * LCD_ISR()                    - ISR for Timer0 to call from MAIN Interrupt routine(LCD_ASYNC only)
  *
  * Other ways to print a char
  * LCD_print(1,10,"a")          - Print as a string to specific location
  * Set_LCD(L_DATA,'a')          - Send the char to current location of LCD as a Data input
  *
+ With LCD_SHADOW enabled in lcd.h the print functions draw into RAM, and nothing
+ reaches the LCD until LCD_refresh() is called. A screen redrawn with the same
+ text costs nothing; a changed digit costs one address command and one
+ character. Do not use Set_LCD(L_DATA, ...) directly in this mode.
+ *
  The LCD library works with all LCD displays that are compatible with the
  Hitachi HD44780 driver. There are many of them out there, and you
  can usually tell them by the 16-pin interface.
@@ -40,27 +48,48 @@
  The circuit:
  * LCD RS pin define as LCD_RS in lcd.h
  * LCD E pin define as LCD_E in lcd.h
- * LCD D4 pin define as LCD_4 in lcd.h
- * LCD D5 pin define as LCD_5 in lcd.h
- * LCD D6 pin define as LCD_6 in lcd.h
- * LCD D7 pin define as LCD_7 in lcd.h
- * LCD R/W pin to ground
+ * LCD D4-D7 on adjacent bits of one port define as LCD_DATA_PORT_ID and LCD_DATA_SHIFT in lcd.h
+ * LCD R/W pin to ground, or define as LCD_RW in lcd.h with LCD_RW_PIN ENABLE
  * 10K resistor: connect ends to +5V and ground, wiper to LCD VO pin(LCD pin 3)
  *
  * Connections should be defined in lcd.h along with direction controls
  * eg:-
  * #define LCD_RS_dir TRISB0
  * #define LCD_E_dir TRISB1
- * #define LCD_4_dir TRISB4
- * #define LCD_5_dir TRISB5
- * #define LCD_6_dir TRISB6
- * #define LCD_7_dir TRISB7
+ * #define LCD_DATA_PORT_ID B
+ * #define LCD_DATA_SHIFT 4
  */
 
 /*******************************************************************************
 * PRIVATE GLOBAL VARIABLES                                                     *
 *******************************************************************************/
 
+#if LCD_ASYNC == ENABLE
+// Queue of bytes for the LCD, filled by Set_LCD and sent by LCD_ISR. The RS
+// value of each byte is a bit in lcd_queue_rs.
+static unsigned char lcd_queue[LCD_QUEUE_SIZE];
+static unsigned char lcd_queue_rs[(LCD_QUEUE_SIZE + 7) / 8];
+static volatile unsigned char lcd_queue_save = 0;
+static volatile unsigned char lcd_queue_read = 0;
+static volatile unsigned char lcd_ticks = 0;    // Ticks to skip before the next nibble
+static volatile bit lcd_low_nibble = FALSE;     // Low nibble of lcd_byte still to send
+static unsigned char lcd_byte;
+static bit lcd_rs;
+static unsigned int lcd_dropped = 0;
+#else
+static void LCD_wait(unsigned char rs, unsigned char datain);
+#endif
+
+#if LCD_SHADOW == ENABLE
+static unsigned char lcd_shadow[LCD_ROWS][LCD_COLS];        // Characters to show
+static unsigned char lcd_dirty[LCD_ROWS][(LCD_COLS + 7) / 8];   // Cells not sent yet
+static unsigned char lcd_row = 0;           // Cursor of the shadow
+static unsigned char lcd_col = 0;
+static unsigned char lcd_address = 0;       // DDRAM address of the LCD cursor
+const unsigned char lcd_row_address[4] = {0, SECOND_ROW, THIRD_ROW, FOURTH_ROW};
+
+static void LCD_fillShadow(void);
+#endif
 
 
 /*******************************************************************************
@@ -80,25 +109,38 @@ void LCD_begin(void)
 {
     LCD_RS_dir = 0;     // Set as Output
     LCD_E_dir = 0;
+#if LCD_RW_PIN == ENABLE
+    LCD_RW_dir = 0;
+    LCD_RW = 0;         // Write
+#endif
 
-    LCD_4_dir = 0;
-    LCD_5_dir = 0;
-    LCD_6_dir = 0;
-    LCD_7_dir = 0;
+    LCD_DATA_TRIS &= ~LCD_DATA_MASK;
     
     LCD_RS = 0;         // RS  = 0
     LCD_E = 0;          // E  = 0
 
-    LCD_4 = 0;          // Data bus = 0
-    LCD_5 = 0;
-    LCD_6 = 0;
-    LCD_7 = 0;
+    LCD_DATA_PORT &= ~LCD_DATA_MASK;    // Data bus = 0
+
+    // The busy flag can not be read until the interface is set, so the
+    // first nibbles are timed(datasheet: initializing by instruction).
+    __delay_ms(LCD_POWER_ON_MS);            // Power on Delay for LCD
+    Set_LCD_Pins8(0, 0x03);                 // Send 0x30 as command to LCD
+    _delay(LCD_DELAY_CYCLES(LCD_INIT1_US));
+    Set_LCD_Pins8(0, 0x03);                 // Functions set for 8 bit interfacing
+    _delay(LCD_DELAY_CYCLES(LCD_INIT2_US));
+    Set_LCD_Pins8(0, 0x03);                 // Repeat 3 times
+    _delay(LCD_DELAY_CYCLES(LCD_CMD_US));
+    Set_LCD_Pins8(0, 0x02);                 // Change Functions set to 4 bit interfacing
+    _delay(LCD_DELAY_CYCLES(LCD_CMD_US));
 
-    __delay_ms(100);           // Power on Delay for LCD
-    Set_LCD_Pins8(0, 0x03);     // Send 0x30 as command to LCD
-    Set_LCD_Pins8(0, 0x03);     // Functions set for 8 bit interfacing
-    Set_LCD_Pins8(0, 0x03);     // Repeat 3 times
-    Set_LCD_Pins8(0, 0x02);     // Change Functions set to 4 bit interfacing
+#if LCD_ASYNC == ENABLE
+    // Timer0 on the instruction clock without prescaler, overflows every 256
+    // cycles. LCD_ISR turns its interrupt off while the queue is empty.
+    T0CS = 0;
+    PSA = 1;
+    T0IE = 0;
+    GIE = 1;
+#endif
 
     Set_LCD(L_CMD, FUNCTION_SET | DL_4 | TWO_LINE | NORMAL_FONT);   // Command entered in 4 bit mode from now on
     Set_LCD(L_CMD, DISPLAY_CONTROL | DISP_OFF);
@@ -106,6 +148,14 @@ void LCD_begin(void)
     Set_LCD(L_CMD, ENTRY_MODE_SET | INC_MODE | NO_SHIFT);
     Set_LCD(L_CMD, DISPLAY_CONTROL | DISP_ON | CURS_OFF);
 
+#if LCD_SHADOW == ENABLE
+    // The display is blank after CLEAR, so is the shadow
+    LCD_fillShadow();
+    for (unsigned char row = 0; row < LCD_ROWS; row++)
+        for (unsigned char i = 0; i < (LCD_COLS + 7) / 8; i++)
+            lcd_dirty[row][i] = 0;
+    lcd_address = 0;
+#endif
 }
 
 /*******************************************************************************
@@ -130,7 +180,7 @@ void LCD_print (unsigned char line, unsigned char pos, unsigned char *str)
 
     // Print each character until end
     while(*str)
-        Set_LCD(1, *str++);
+        LCD_putchar(*str++);
 }
 
 /*******************************************************************************
@@ -144,14 +194,183 @@ void LCD_print (unsigned char line, unsigned char pos, unsigned char *str)
 * ~ void
 *
 * DESCRIPTIONS:
-* Set the output of the LCD RS pin and data bus.
+* Set the output of the LCD RS pin and data bus, then wait until the LCD
+* has carried out the command.
 *
 *******************************************************************************/
 void Set_LCD (unsigned char rs, unsigned char datain)
 {
+#if LCD_ASYNC == ENABLE
+    unsigned char mask = 1 << (lcd_queue_save & 7);
+
+#if LCD_QUEUE_FULL == LCD_DROP
+    if ((unsigned char)(lcd_queue_save - lcd_queue_read) == LCD_QUEUE_SIZE)
+    {
+        lcd_dropped++;
+        return;
+    }
+#else
+    while ((unsigned char)(lcd_queue_save - lcd_queue_read) == LCD_QUEUE_SIZE)
+        NOP();
+#endif
+    lcd_queue[lcd_queue_save & (LCD_QUEUE_SIZE - 1)] = datain;
+    if (rs)
+        lcd_queue_rs[(lcd_queue_save & (LCD_QUEUE_SIZE - 1)) >> 3] |= mask;
+    else
+        lcd_queue_rs[(lcd_queue_save & (LCD_QUEUE_SIZE - 1)) >> 3] &= ~mask;
+    lcd_queue_save++;
+    T0IE = 1;           // LCD_ISR sends it
+#else
     Set_LCD_Pins8(rs, (datain>>4) & 0x0F);
     Set_LCD_Pins8(rs, datain & 0x0F);
+    LCD_wait(rs, datain);
+#endif
+}
+
+#if LCD_ASYNC == ENABLE
+/*******************************************************************************
+* PUBLIC FUNCTION: LCD_ISR
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Timer0 interrupt: send the next nibble of the queue, or skip the tick while
+* the LCD carries out the last command(CLEAR and HOME need about 12 ticks at
+* 8MHz, anything else is done by the next tick).
+*
+*******************************************************************************/
+void LCD_ISR(void)
+{
+    T0IF = 0;
+    if (lcd_ticks)
+    {
+        lcd_ticks--;
+        return;
+    }
+    if (lcd_low_nibble)
+    {
+        Set_LCD_Pins8(lcd_rs, lcd_byte & 0x0F);
+        lcd_low_nibble = FALSE;
+        if (!lcd_rs && (lcd_byte == CLEAR || (lcd_byte & 0xFE) == HOME))
+            lcd_ticks = LCD_WAIT_TICKS(LCD_CLEAR_US);
+        else if (lcd_rs)
+            lcd_ticks = LCD_WAIT_TICKS(LCD_DATA_US);
+        else
+            lcd_ticks = LCD_WAIT_TICKS(LCD_CMD_US);
+        return;
+    }
+    if (lcd_queue_read == lcd_queue_save)
+    {
+        T0IE = 0;       // Queue sent, Set_LCD starts again
+        return;
+    }
+    lcd_byte = lcd_queue[lcd_queue_read & (LCD_QUEUE_SIZE - 1)];
+    lcd_rs = (lcd_queue_rs[(lcd_queue_read & (LCD_QUEUE_SIZE - 1)) >> 3] >> (lcd_queue_read & 7)) & 1;
+    lcd_queue_read++;
+    Set_LCD_Pins8(lcd_rs, (lcd_byte >> 4) & 0x0F);
+    lcd_low_nibble = TRUE;
+}
+
+/*******************************************************************************
+* PUBLIC FUNCTION: LCD_idle
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ bit                 - TRUE once the queue is sent and the LCD is done
+*
+* DESCRIPTIONS:
+* Check that LCD_ISR will not touch the LCD pins. Wait for it before the data
+* bus is used for anything else, eg:- the multiplexed keypad.
+*
+*******************************************************************************/
+bit LCD_idle(void)
+{
+    return lcd_queue_read == lcd_queue_save && !lcd_low_nibble && lcd_ticks == 0;
+}
+
+/*******************************************************************************
+* PUBLIC FUNCTION: LCD_dropCount
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ unsigned int        - Bytes dropped with the queue full(LCD_DROP)
+*
+* DESCRIPTIONS:
+* Number of bytes Set_LCD dropped since LCD_begin.
+*
+*******************************************************************************/
+unsigned int LCD_dropCount(void)
+{
+    return lcd_dropped;
 }
+#endif
+
+/*******************************************************************************
+* PRIVATE FUNCTION: LCD_wait
+*
+* PARAMETERS:
+* ~ rs                  - 0 for command, 1 for data
+* ~ datain		- Command/Data just sent
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Wait until the LCD is ready for the next command. With LCD_RW_PIN the busy
+* flag(DB7) is polled; the address counter comes in the second nibble and is
+* dropped. Without it, or when the flag stays set for LCD_BUSY_POLLS reads, the
+* datasheet time of the command is waited(see LCD_CLEAR_US, LCD_DATA_US and
+* LCD_CMD_US in lcd.h).
+*
+*******************************************************************************/
+#if LCD_ASYNC != ENABLE
+static void LCD_wait(unsigned char rs, unsigned char datain)
+{
+#if LCD_RW_PIN == ENABLE
+    unsigned char busy;
+    unsigned int polls = LCD_BUSY_POLLS;
+
+    LCD_DATA_TRIS |= LCD_DATA_MASK;     // Set as Input
+    LCD_RS = 0;
+    LCD_RW = 1;         // Read busy flag and address
+    do
+    {
+        LCD_E = 1;
+        NOP();          // Data is valid 360ns after E rises
+#if _XTAL_FREQ > 8000000
+        __delay_us(1);  // E high 450ns, enable cycle 1000ns
+#endif
+        busy = LCD_DATA_PORT & LCD_BUSY_MASK;
+        LCD_E = 0;
+        LCD_E = 1;
+        NOP();
+#if _XTAL_FREQ > 8000000
+        __delay_us(1);
+#endif
+        LCD_E = 0;
+    } while (busy && --polls);
+    LCD_RW = 0;
+    LCD_DATA_TRIS &= ~LCD_DATA_MASK;    // Set as Output
+    if (!busy)
+        return;
+    // Still busy: the LCD does not answer, wait the datasheet time instead
+#endif
+    if (rs == L_DATA)
+        _delay(LCD_DELAY_CYCLES(LCD_DATA_US));
+    else if (datain == CLEAR || (datain & 0xFE) == HOME)
+        _delay(LCD_DELAY_CYCLES(LCD_CLEAR_US));
+    else
+        _delay(LCD_DELAY_CYCLES(LCD_CMD_US));
+}
+#endif
 
 /*******************************************************************************
 * PRIVATE FUNCTION: Set_LCD_Pins8
@@ -165,23 +384,21 @@ void Set_LCD (unsigned char rs, unsigned char datain)
 *
 * DESCRIPTIONS:
 * Set the output of the LCD RS pin and data bus but, only the LOWER NIBBLE.
+* The nibble is latched on the falling edge of E; the caller waits for the
+* LCD(see LCD_wait).
 *
 *******************************************************************************/
 void Set_LCD_Pins8 (unsigned char rs, unsigned char datain)
 {
-    LCDPINS = datain;
-
     LCD_RS = rs;
 
-    LCD_4 = LCDPINS_0;
-    LCD_5 = LCDPINS_1;
-    LCD_6 = LCDPINS_2;
-    LCD_7 = LCDPINS_3;
+    LCD_DATA_PORT = (LCD_DATA_PORT & ~LCD_DATA_MASK) | ((datain << LCD_DATA_SHIFT) & LCD_DATA_MASK);
 
     LCD_E = 1;
-    __delay_ms (1);
+#if _XTAL_FREQ > 8000000
+    __delay_us(1);      // E must stay high for 450ns
+#endif
     LCD_E = 0;
-    __delay_ms (10);
 }
 
 /*******************************************************************************
@@ -199,8 +416,13 @@ void Set_LCD_Pins8 (unsigned char rs, unsigned char datain)
 *******************************************************************************/
 void LCD_clear(void)
 {
+#if LCD_SHADOW == ENABLE
+    // Blank the shadow; LCD_refresh sends only the cells that were not blank.
+    LCD_fillShadow();
+#else
 	// Send the command to clear the LCD display.
 	Set_LCD(L_CMD, CLEAR);
+#endif
 }
 
 /*******************************************************************************
@@ -218,8 +440,13 @@ void LCD_clear(void)
 *******************************************************************************/
 void LCD_home(void)
 {
+#if LCD_SHADOW == ENABLE
+    lcd_row = 0;
+    lcd_col = 0;
+#else
 	// Send the command to return the cursor to the home position.
 	Set_LCD(L_CMD, HOME);
+#endif
 }
 
 /*******************************************************************************
@@ -273,6 +500,10 @@ void LCD_noDisplay(void)
 *******************************************************************************/
 void LCD_setCursor(unsigned char line, unsigned char pos)
 {
+#if LCD_SHADOW == ENABLE
+    lcd_row = (line >= 2 && line <= 4) ? line - 1 : 0;
+    lcd_col = pos - 1;
+#else
 	// Send the command to jump to the defined position.
     if (line == 4)
 	Set_LCD(L_CMD, (SET_DDRAM_ADDRESS | FOURTH_ROW) + pos - 1);
@@ -282,6 +513,7 @@ void LCD_setCursor(unsigned char line, unsigned char pos)
 	Set_LCD(L_CMD, (SET_DDRAM_ADDRESS | SECOND_ROW) + pos - 1);
     else
 	Set_LCD(L_CMD, SET_DDRAM_ADDRESS + pos - 1);
+#endif
 }
 
 
@@ -301,8 +533,21 @@ void LCD_setCursor(unsigned char line, unsigned char pos)
 *******************************************************************************/
 void LCD_putchar(char datain)
 {
+#if LCD_SHADOW == ENABLE
+    // Only a changed cell has to be sent; characters past the edge are dropped
+    if (lcd_row < LCD_ROWS && lcd_col < LCD_COLS)
+    {
+        if (lcd_shadow[lcd_row][lcd_col] != (unsigned char)datain)
+        {
+            lcd_shadow[lcd_row][lcd_col] = datain;
+            lcd_dirty[lcd_row][lcd_col >> 3] |= 1 << (lcd_col & 7);
+        }
+        lcd_col++;
+    }
+#else
 	// Send the data to display.
 	Set_LCD(1, (unsigned char)datain);
+#endif
 }
 
 /*******************************************************************************
@@ -339,3 +584,76 @@ void LCD_BCDprint(unsigned char required_digits, unsigned int the_number)
     }
 }
 
+#if LCD_SHADOW == ENABLE
+/*******************************************************************************
+* PRIVATE FUNCTION: LCD_fillShadow
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Blank every cell of the shadow and return its cursor to the home position.
+*
+*******************************************************************************/
+static void LCD_fillShadow(void)
+{
+    for (lcd_row = 0; lcd_row < LCD_ROWS; lcd_row++)
+        for (lcd_col = 0; lcd_col < LCD_COLS; lcd_col++)
+            if (lcd_shadow[lcd_row][lcd_col] != ' ')
+            {
+                lcd_shadow[lcd_row][lcd_col] = ' ';
+                lcd_dirty[lcd_row][lcd_col >> 3] |= 1 << (lcd_col & 7);
+            }
+    lcd_row = 0;
+    lcd_col = 0;
+}
+
+/*******************************************************************************
+* PUBLIC FUNCTION: LCD_refresh
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Send the cells changed since the last refresh. A run of changed cells costs
+* one SET_DDRAM_ADDRESS and the characters, the LCD increments the address.
+* The LCD cursor is then moved to the shadow cursor if it is not there.
+*
+*******************************************************************************/
+void LCD_refresh(void)
+{
+    unsigned char row;
+    unsigned char col;
+    unsigned char mask;
+    unsigned char address;
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (col = 0; col < LCD_COLS; col++)
+        {
+            mask = 1 << (col & 7);
+            if (!(lcd_dirty[row][col >> 3] & mask))
+                continue;
+            lcd_dirty[row][col >> 3] &= ~mask;
+            address = lcd_row_address[row] + col;
+            if (address != lcd_address)
+                Set_LCD(L_CMD, SET_DDRAM_ADDRESS | address);    // Start of a run
+            Set_LCD(L_DATA, lcd_shadow[row][col]);
+            lcd_address = address + 1;
+        }
+    }
+
+    address = lcd_row_address[lcd_row] + lcd_col;
+    if (address != lcd_address)
+    {
+        Set_LCD(L_CMD, SET_DDRAM_ADDRESS | address);
+        lcd_address = address;
+    }
+}
+#endif
@@ -15,55 +15,87 @@
 
 #include "system.h"
 
-volatile unsigned char           LCDPINS              @ 0x190;
-//LCD bit and bitfield definitions
-volatile bit LCDPINS_0              @ ((unsigned)&LCDPINS*8)+0;
-volatile bit LCDPINS_1              @ ((unsigned)&LCDPINS*8)+1;
-volatile bit LCDPINS_2              @ ((unsigned)&LCDPINS*8)+2;
-volatile bit LCDPINS_3              @ ((unsigned)&LCDPINS*8)+3;
-volatile bit LCDPINS_4              @ ((unsigned)&LCDPINS*8)+4;
-volatile bit LCDPINS_5              @ ((unsigned)&LCDPINS*8)+5;
-volatile bit LCDPINS_6              @ ((unsigned)&LCDPINS*8)+6;
-volatile bit LCDPINS_7              @ ((unsigned)&LCDPINS*8)+7;
-
-#ifndef _LIB_BUILD
-volatile union {
-    struct {
-        unsigned    LCDPINS_0              : 1;
-        unsigned    LCDPINS_1              : 1;
-        unsigned    LCDPINS_2              : 1;
-        unsigned    LCDPINS_3              : 1;
-        unsigned    LCDPINS_4              : 1;
-        unsigned    LCDPINS_5              : 1;
-        unsigned    LCDPINS_6              : 1;
-        unsigned    LCDPINS_7              : 1;
-    };
-} LCDPINSbits @ 0x190;
-#endif
-
-
 // Pin defines for HD44780 based Character LCD
 #define LCD_RS			RA0		// RS pin is used for LCD to differentiate data is command or character
 #define LCD_E			RA1		// Enable pin
+#define LCD_RW			RA2		// Read/Write pin(only with LCD_RW_PIN ENABLE)
 
-// Data bus for 4 bit mode
-#define LCD_4			RB4
-#define LCD_5			RB5
-#define LCD_6			RB6
-#define LCD_7			RB7
+// Data bus for 4 bit mode: D4-D7 on four adjacent bits of one port, D4 on bit
+// LCD_DATA_SHIFT(here RB4-RB7). The port, its TRIS register and the masks all
+// follow from these two, and the nibble is written to the port at once.
+#define LCD_DATA_PORT_ID	B
+#define LCD_DATA_SHIFT		4
 
 // TRIS Setting for a pins
 #define LCD_RS_dir		TRISA0
 #define LCD_E_dir		TRISA1
-
-#define LCD_4_dir		TRISB4
-#define LCD_5_dir		TRISB5
-#define LCD_6_dir		TRISB6
-#define LCD_7_dir		TRISB7
+#define LCD_RW_dir		TRISA2
+
+#define LCD_PASTE(a, b)		a##b
+#define LCD_PORT(id)		LCD_PASTE(PORT, id)
+#define LCD_TRIS(id)		LCD_PASTE(TRIS, id)
+#define LCD_DATA_PORT		LCD_PORT(LCD_DATA_PORT_ID)
+#define LCD_DATA_TRIS		LCD_TRIS(LCD_DATA_PORT_ID)
+#define LCD_DATA_MASK		(0x0F << LCD_DATA_SHIFT)
+#define LCD_BUSY_MASK		(0x08 << LCD_DATA_SHIFT)	// D7, the busy flag
+
+#if LCD_DATA_SHIFT > 4
+#error "LCD_DATA_SHIFT must leave D7 on the port, 4 at most"
+#endif
 
 /*******************************************************************************
 * PRIVATE CONSTANTS                                                            *
 *******************************************************************************/
+// ENABLE if the LCD R/W pin is connected to LCD_RW: the busy flag(DB7) is read
+// after every command, so each one takes only as long as the LCD needs.
+// DISABLE if R/W is tied to ground: a fixed delay per command is used instead.
+#define LCD_RW_PIN              DISABLE
+
+// ENABLE to draw into a RAM copy of the display: LCD_print, LCD_putchar and
+// LCD_BCDprint only change the copy, and LCD_refresh sends the changed cells.
+// Costs LCD_ROWS * LCD_COLS bytes of RAM and a bit per cell.
+#define LCD_SHADOW              DISABLE
+#define LCD_ROWS                2
+#define LCD_COLS                16
+
+// Execution times from the HD44780 datasheet(270kHz LCD oscillator), used when
+// the busy flag can not be read. Raise them for slower clones.
+#define LCD_CLEAR_US            1520    // CLEAR and HOME
+#define LCD_DATA_US             37      // Character write
+#define LCD_CMD_US              37      // Any other command
+// Power on sequence: wait after power on, after the first and the second 0x3 nibble
+#define LCD_POWER_ON_MS         40
+#define LCD_INIT1_US            4100
+#define LCD_INIT2_US            100
+// Busy flag reads before LCD_wait falls back to the times above, so a missing
+// or broken LCD can not hang the program. A read takes 2us at least(E high 1us
+// twice; about 6us at 8MHz), so a healthy LCD ends CLEAR well before the cap.
+#define LCD_BUSY_POLLS          LCD_CLEAR_US
+
+// ENABLE to queue the LCD output and send it from the Timer0 interrupt(LCD_ISR),
+// one nibble per Timer0 overflow(256 instruction cycles, 128us at 8MHz). The
+// waits come from the timing table above; the busy flag is not read.
+#define LCD_ASYNC               DISABLE
+#define LCD_QUEUE_SIZE          32      // Power of two, 128 at most
+// What Set_LCD does when the queue is full: LCD_BLOCK waits for room,
+// LCD_DROP drops the byte(see LCD_dropCount)
+#define LCD_BLOCK               0
+#define LCD_DROP                1
+#define LCD_QUEUE_FULL          LCD_BLOCK
+
+#if (LCD_QUEUE_SIZE & (LCD_QUEUE_SIZE - 1)) || (LCD_QUEUE_SIZE > 128)
+#error "LCD_QUEUE_SIZE must be a power of two, 128 at most"
+#endif
+
+// Instruction cycles already spent between the E pulse and the delay
+#define LCD_OVERHEAD_CYCLES     8
+// Delay cycles for a time in microseconds, solved at compile time for _delay()
+#define LCD_CYCLES(us)          ((unsigned long)(us) * (_XTAL_FREQ / 4000UL) / 1000 + 1)
+#define LCD_DELAY_CYCLES(us)    (LCD_CYCLES(us) > LCD_OVERHEAD_CYCLES \
+                                    ? LCD_CYCLES(us) - LCD_OVERHEAD_CYCLES : 1)
+// Timer0 ticks to skip after a nibble for a time in microseconds
+#define LCD_WAIT_TICKS(us)      ((LCD_CYCLES(us) + 255) / 256 - 1)
+
 /* The protocol for the LCD
 R/S	DB7	DB6	DB5	DB4	DB3	DB2	DB1	DB0	Functions
 0	0	0	0	0	0	0	0	1	Clear LCD
@@ -151,6 +183,10 @@ void LCD_clear(void);
 void LCD_home(void);
 void LCD_display(void);
 void LCD_noDisplay(void);
+void LCD_refresh(void);
+void LCD_ISR(void);
+bit LCD_idle(void);
+unsigned int LCD_dropCount(void);
 
 
 #endif
@@ -48,6 +48,31 @@ void interrupt ISR(void)
     {
         Serial_ReadISR();
     }
+    if (TXIE && TXIF)
+    {
+        Serial_WriteISR();
+    }
+    // Add this code in the ISR if LCD_ASYNC is enabled in lcd.h
+//    if (T0IE && T0IF)
+//    {
+//        LCD_ISR();
+//    }
+    // Add this code in the ISR if the software serial port(softserial.c) is used
+//    if (TMR2IE && TMR2IF)
+//    {
+//        SoftSerial_ISR();
+//    }
+    // Add this code in the ISR if RS485 or FLOW_CONTROL is enabled in serial.h
+//    if (CCP1IE && CCP1IF)
+//    {
+//        Serial_CompareISR();
+//    }
+    // Add this code in the ISR if FRAME_DETECT is enabled in serial.h
+    // (call Modbus_GapISR instead when modbus.c is used)
+//    if (CCP2IE && CCP2IF)
+//    {
+//        Serial_GapISR();
+//    }
 
 }
 //	Main function
@@ -79,6 +104,9 @@ void main(void)
     Set_LCD(L_CMD, DISPLAY_CONTROL | DISP_ON | CURS_ON | BLINK);
     LCD_setCursor(2,14);
 
+    // With BRIDGE enabled in serial.h this echoes from the ISR instead of the loop below
+//    Serial_bridge(&Serial, 0);
+
     //loop forever
     while(1)
     {
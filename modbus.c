@@ -0,0 +1,187 @@
+/*
+ * File:   modbus.c
+ *
+ * Created on 17 October 2026
+ */
+
+// include the header for the Modbus library:
+#include "modbus.h"
+
+
+/*******************************************************************************
+* This file provides a Modbus RTU slave on the Serial port(Hardware)
+*******************************************************************************/
+
+/*
+ Each byte is added to the frame buffer and the running CRC from
+ Serial_ReadISR, so a request is checked the moment the line goes silent.
+ Modbus_GapISR then calls the register callbacks and queues the response in
+ the outgoing buffer, where Serial_WriteISR(and RS485, if enabled) sends it.
+ The response is built in the frame buffer first, so a failing register
+ gives an exception response instead of a partial one.
+ */
+
+static unsigned char modbus_address;
+static Modbus_read modbus_read;
+static Modbus_write modbus_write;
+
+static unsigned char modbus_frame[MODBUS_FRAME_SIZE];
+static unsigned char modbus_length;     // Bytes received, more than the buffer on overflow
+static unsigned int modbus_crc;         // CRC of the received bytes, CRC16_OK when valid
+static unsigned int modbus_requests;
+static unsigned int modbus_errors;
+
+static void Modbus_receive(unsigned char x);
+static unsigned char Modbus_answer(void);
+static void Modbus_send(unsigned char length);
+
+// Answers Modbus RTU requests for address on the Serial port
+void Modbus_begin(unsigned char address, Modbus_read read, Modbus_write write)
+{
+    modbus_address = address;
+    modbus_read = read;
+    modbus_write = write;
+    modbus_length = 0;
+    modbus_crc = CRC16_INIT;
+    modbus_requests = 0;
+    modbus_errors = 0;
+    Serial_bridge(0, Modbus_receive);
+}
+
+// Stops answering
+void Modbus_end(void)
+{
+    Serial_bridgeEnd();
+}
+
+// Bridge hook: collects a request byte
+static void Modbus_receive(unsigned char x)
+{
+    if (modbus_length < MODBUS_FRAME_SIZE)
+    {
+        modbus_frame[modbus_length] = x;
+        modbus_crc = CRC16_update(modbus_crc, x);
+    }
+    if (modbus_length != 0xFF)
+        modbus_length++;
+}
+
+// Checks and answers a request after 3.5 characters of silence
+void Modbus_GapISR(void)
+{
+    Serial_GapISR();
+    Serial_frameEnded();    // The frame is handled here
+    if (modbus_length == 0)
+        return;
+    if (modbus_length < 4 || modbus_length > MODBUS_FRAME_SIZE || modbus_crc != CRC16_OK)
+        modbus_errors++;    // Noise, bad CRC or longer than any accepted request
+    else if (modbus_frame[0] == modbus_address || modbus_frame[0] == MODBUS_BROADCAST)
+    {
+        modbus_length = Modbus_answer();
+        modbus_requests++;
+        if (modbus_frame[0] != MODBUS_BROADCAST)
+            Modbus_send(modbus_length);
+    }
+    modbus_length = 0;
+    modbus_crc = CRC16_INIT;
+}
+
+// Carries out the request in modbus_frame and builds the response in its place.
+// Returns the response length, CRC not included.
+static unsigned char Modbus_answer(void)
+{
+    unsigned char function = modbus_frame[1];
+    unsigned int reg = ((unsigned int)modbus_frame[2] << 8) | modbus_frame[3];
+    unsigned int count = ((unsigned int)modbus_frame[4] << 8) | modbus_frame[5];
+    unsigned int value;
+    unsigned char i;
+    unsigned char code = 0;
+
+    if (function == MODBUS_READ_HOLDING || function == MODBUS_READ_INPUT)
+    {
+        if (modbus_length != 8 || count == 0 || count > MODBUS_MAX_REGS)
+            code = MODBUS_ILLEGAL_VALUE;
+        else
+        {
+            for (i = 0; i < count && !code; i++)
+            {
+                if (!modbus_read(function, reg + i, &value))
+                    code = MODBUS_ILLEGAL_ADDRESS;
+                modbus_frame[3 + 2 * i] = value >> 8;
+                modbus_frame[4 + 2 * i] = value & 0xff;
+            }
+            modbus_frame[2] = 2 * count;
+            if (!code)
+                return 3 + 2 * count;
+        }
+    }
+    else if (function == MODBUS_WRITE_SINGLE)
+    {
+        if (modbus_length != 8)
+            code = MODBUS_ILLEGAL_VALUE;
+        else if (!modbus_write(reg, count))
+            code = MODBUS_ILLEGAL_ADDRESS;
+        else
+            return 6;   // Echo of the request
+    }
+    else if (function == MODBUS_WRITE_MULTIPLE)
+    {
+        if (count == 0 || count > MODBUS_MAX_REGS || modbus_frame[6] != 2 * count
+            || modbus_length != 9 + 2 * count)
+            code = MODBUS_ILLEGAL_VALUE;
+        else
+        {
+            for (i = 0; i < count && !code; i++)
+            {
+                value = ((unsigned int)modbus_frame[7 + 2 * i] << 8) | modbus_frame[8 + 2 * i];
+                if (!modbus_write(reg + i, value))
+                    code = MODBUS_ILLEGAL_ADDRESS;
+            }
+            if (!code)
+                return 6;   // Address, function, start and quantity
+        }
+    }
+    else
+        code = MODBUS_ILLEGAL_FUNCTION;
+
+    modbus_frame[1] = function | 0x80;
+    modbus_frame[2] = code;
+    return 3;
+}
+
+// Queues the response and its CRC in the outgoing buffer
+static void Modbus_send(unsigned char length)
+{
+    unsigned int crc = CRC16_block(modbus_frame, length);
+    unsigned char i;
+
+    if (Serial_availableForWrite() < length + 2)
+    {
+        modbus_errors++;    // The main code is still sending
+        return;
+    }
+    for (i = 0; i < length; i++)
+        Serial_tryWrite(modbus_frame[i]);
+    Serial_tryWrite(crc & 0xff);    // Low byte first
+    Serial_tryWrite(crc >> 8);
+}
+
+// Number of requests answered since Modbus_begin
+unsigned int Modbus_requestCount(void)
+{
+    unsigned int count;
+    GIE = 0;            // The counter is 16-bit, keep Modbus_GapISR out while reading
+    count = modbus_requests;
+    GIE = 1;
+    return count;
+}
+
+// Number of frames dropped since Modbus_begin
+unsigned int Modbus_errorCount(void)
+{
+    unsigned int count;
+    GIE = 0;
+    count = modbus_errors;
+    GIE = 1;
+    return count;
+}
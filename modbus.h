@@ -0,0 +1,70 @@
+/*
+ * File:   modbus.h
+ *
+ * Created on 17 October 2026
+ */
+
+#ifndef MODBUS_H
+#define	MODBUS_H
+
+#include "serial.h"
+#include "crc16.h"
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+//Most registers in one request(functions 3, 4 and 16). A response must fit in
+//the outgoing buffer: 5 bytes and 2 per register.
+#define MODBUS_MAX_REGS     13
+#define MODBUS_FRAME_SIZE   (9 + 2 * MODBUS_MAX_REGS)
+
+#if 5 + 2 * MODBUS_MAX_REGS > TX_BUF_SIZE
+#error "MODBUS_MAX_REGS responses do not fit in TX_BUF_SIZE"
+#endif
+#if BRIDGE != ENABLE || FRAME_DETECT != ENABLE
+#error "Modbus needs BRIDGE and FRAME_DETECT in serial.h"
+#endif
+
+//Function codes
+#define MODBUS_READ_HOLDING     3
+#define MODBUS_READ_INPUT       4
+#define MODBUS_WRITE_SINGLE     6
+#define MODBUS_WRITE_MULTIPLE   16
+
+//Exception codes
+#define MODBUS_ILLEGAL_FUNCTION 1
+#define MODBUS_ILLEGAL_ADDRESS  2
+#define MODBUS_ILLEGAL_VALUE    3
+
+#define MODBUS_BROADCAST        0
+
+// Register callbacks, called from the interrupt. function is MODBUS_READ_HOLDING
+// or MODBUS_READ_INPUT. Return FALSE for a register that does not exist.
+typedef unsigned char (*Modbus_read)(unsigned char function, unsigned int reg, unsigned int *value);
+typedef unsigned char (*Modbus_write)(unsigned int reg, unsigned int value);
+
+
+/*******************************************************************************
+* FUNCTION PROTOTYPES                                                          *
+*******************************************************************************/
+// Answers Modbus RTU requests for address on the Serial port. Start the port
+// first, eg:- Serial_begin(19200); Modbus_begin(1, readRegister, writeRegister);
+// Requests are taken byte by byte in Serial_ReadISR(as a bridge hook) and
+// answered in Modbus_GapISR, so the main code does not have to poll.
+// The response is queued from the interrupt, so the main code must not write
+// to Serial(Serial_write, Serial_print...) until Modbus_end, as with Serial_bridge.
+void Modbus_begin(unsigned char address, Modbus_read read, Modbus_write write);
+
+// Stops answering, received bytes go to the incoming buffer again
+void Modbus_end(void);
+
+// ISR function to call for the CCP2 compare interrupt(only when CCP2IE is set),
+// instead of Serial_GapISR. Checks and answers a request after 3.5 characters
+// of silence(FRAME_GAP in serial.h).
+void Modbus_GapISR(void);
+
+// Number of requests answered and dropped(bad CRC, too long) since Modbus_begin
+unsigned int Modbus_requestCount(void);
+unsigned int Modbus_errorCount(void);
+
+#endif	/* MODBUS_H */
@@ -0,0 +1,146 @@
+/*
+ * File:   packet.c
+ *
+ * Created on 17 October 2026
+ */
+
+// include the header for packet library:
+#include "packet.h"
+
+
+/*******************************************************************************
+* This file provides framed, CRC checked packets over the Serial port
+*******************************************************************************/
+
+/*
+ A frame is the payload followed by its CRC-16(low byte first), COBS encoded and
+ ended by 0x00. COBS removes every 0x00 from the frame: each block starts with a
+ code byte giving the distance to the next zero, so a 0x00 is always the end of
+ a frame and a receiver can resynchronise on any byte.
+
+ The decoder takes the bytes straight from the serial buffer into
+ packet_buffer and updates the CRC as it goes, so the frame is checked the
+ moment its delimiter arrives.
+ */
+
+unsigned char packet_buffer[PACKET_SIZE + 2];   // Payload and CRC
+static unsigned char packet_length = 0;         // Decoded bytes in packet_buffer
+static unsigned char packet_left = 0;           // Bytes left in the current COBS block
+static unsigned char packet_code = 0;           // Code of the current block, 0 at frame start
+static unsigned int packet_crc = CRC16_INIT;
+static unsigned char packet_ready = 0;          // Payload length of a complete frame
+static bit packet_overflow = FALSE;             // Frame too long, skip to the next 0x00
+
+// Byte number index of the payload and CRC being sent
+static unsigned char Packet_byte(const unsigned char *data, unsigned char length,
+                                 unsigned int crc, unsigned int index)
+{
+    if (index < length)
+        return data[index];
+    if (index == length)
+        return crc & 0xff;
+    return crc >> 8;
+}
+
+// Sends data as one frame: COBS encoded data and CRC-16, followed by 0x00.
+void Serial_sendPacket(const unsigned char *data, unsigned char length)
+{
+    unsigned int crc = CRC16_block(data, length);
+    unsigned int total = (unsigned int)length + 2;
+    unsigned int start = 0;
+    unsigned int end;
+    unsigned int index;
+
+    while (1)
+    {
+        // Find the end of the block: the next zero, the end of data or 254 bytes
+        end = start;
+        while (end < total && end - start < 254 && Packet_byte(data, length, crc, end) != 0)
+            end++;
+        Serial_write(end - start + 1);
+        for (index = start; index < end; index++)
+            Serial_write(Packet_byte(data, length, crc, index));
+        if (end == total)
+            break;
+        if (end - start == 254)
+            start = end;        // Full block, no zero to skip
+        else
+            start = end + 1;    // Skip the zero replaced by the code byte
+    }
+    Serial_write(0);
+}
+
+// Restarts the decoder for a new frame
+static void Packet_reset(void)
+{
+    packet_length = 0;
+    packet_left = 0;
+    packet_code = 0;
+    packet_crc = CRC16_INIT;
+    packet_overflow = FALSE;
+}
+
+// Adds a decoded byte to packet_buffer
+static void Packet_store(unsigned char inByte)
+{
+    if (packet_length == PACKET_SIZE + 2)
+    {
+        packet_overflow = TRUE;
+        return;
+    }
+    packet_buffer[packet_length++] = inByte;
+    packet_crc = CRC16_update(packet_crc, inByte);
+}
+
+// Decodes the bytes waiting in the serial buffer. Returns the payload length of
+// a complete frame with a valid CRC, or 0 if there is none yet. Bad, empty and
+// oversized frames are dropped.
+unsigned char Serial_packetAvailable(void)
+{
+    unsigned char index;
+    unsigned char inByte;
+
+    if (packet_ready)
+        return packet_ready;
+
+    index = Serial.rx_read;
+    while (index != Serial.rx_save)
+    {
+        inByte = read_buffer[index & BUF_MASK];
+        index++;
+        if (inByte == 0)
+        {
+            // End of frame. Complete if no block is cut short and the CRC matches
+            if (!packet_overflow && packet_left == 0 && packet_length > 2 && packet_crc == CRC16_OK)
+                packet_ready = packet_length - 2;
+            Packet_reset();
+            if (packet_ready)
+                break;
+        }
+        else if (packet_overflow)
+            continue;
+        else if (packet_left)
+        {
+            Packet_store(inByte);
+            packet_left--;
+        }
+        else
+        {
+            // New block. The previous block stood for a zero unless it was full
+            if (packet_code && packet_code != 0xFF)
+                Packet_store(0);
+            packet_code = inByte;
+            packet_left = inByte - 1;
+        }
+    }
+    Serial.rx_read = index;
+    return packet_ready;
+}
+
+// Returns the payload of the frame found by Serial_packetAvailable and releases
+// it. The data stays valid until the next call of Serial_packetAvailable.
+unsigned char *Serial_receivePacket(void)
+{
+    packet_ready = 0;
+    return packet_buffer;
+}
@@ -0,0 +1,35 @@
+/*
+ * File:   packet.h
+ *
+ * Created on 17 October 2026
+ */
+
+#ifndef PACKET_H
+#define	PACKET_H
+
+#include "serial.h"
+#include "crc16.h"
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+//Largest payload accepted by Serial_packetAvailable(bytes, CRC not included)
+#define PACKET_SIZE     32
+
+
+/*******************************************************************************
+* FUNCTION PROTOTYPES                                                          *
+*******************************************************************************/
+// Sends data as one frame: COBS encoded data and CRC-16, followed by 0x00.
+void Serial_sendPacket(const unsigned char *data, unsigned char length);
+
+// Decodes the bytes waiting in the serial buffer. Returns the payload length of
+// a complete frame with a valid CRC, or 0 if there is none yet. Bad, empty and
+// oversized frames are dropped.
+unsigned char Serial_packetAvailable(void);
+
+// Returns the payload of the frame found by Serial_packetAvailable and releases
+// it. The data stays valid until the next call of Serial_packetAvailable.
+unsigned char *Serial_receivePacket(void);
+
+#endif	/* PACKET_H */
@@ -7,18 +7,134 @@
 
 // include the header for serial library:
 #include "serial.h"
+#include <stdarg.h>
 
 
 /*******************************************************************************
 * This file provides the functions for the Serial port(Hardware)
 *******************************************************************************/
 
+// Incoming and outgoing circular buffers of the hardware port. The counters are
+// in Serial(see Serial_port in serial.h).
 unsigned char read_buffer[BUF_SIZE];
-int rx_buffer_save_pointer = 0;   // This is a circular buffer save counter.
-int rx_buffer_read_pointer = 0;   // This is a circular buffer read counter.
-int rx_buffer_available = 0; //The available bytes in the buffer. Countable backwards from rx_buffer_save_pointer
-// Start the Serial port
-void Serial_begin(unsigned long baud)
+unsigned char write_buffer[TX_BUF_SIZE];
+
+static void Serial_startTx(void);
+static void Serial_waitTx(void);
+
+// The hardware port. The Serial_ functions use its counters and buffers
+// directly; the SerialPort_ functions reach it through a pointer.
+Serial_port Serial = {
+    read_buffer, BUF_MASK, 0, 0,
+    write_buffer, TX_BUF_MASK, 0, 0,
+    Serial_startTx, Serial_waitTx
+};
+volatile unsigned int rx_buffer_dropped = 0;  // Received bytes lost
+
+// Length of one bit in Timer1 ticks, saturated at 0xFFFF(set by Serial_beginBRG)
+unsigned int serial_bit_ticks;
+
+#if SERIAL_STATS == ENABLE
+volatile Serial_stats serial_stats;
+#endif
+
+#if FLOW_CONTROL != FLOW_NONE
+volatile bit rx_stopped = FALSE;    // Sender told to stop(incoming buffer at FLOW_HIGH)
+#endif
+#if FLOW_CONTROL == FLOW_RTSCTS
+volatile bit tx_stopped = FALSE;    // Waiting for CTS
+#endif
+#if FLOW_CONTROL == FLOW_XONXOFF
+volatile bit tx_stopped = FALSE;    // XOFF received
+volatile unsigned char flow_char = 0;   // XON/XOFF to send before the queued data
+#endif
+
+#if MULTIDROP == ENABLE
+unsigned char serial_address;   // Address of this node on the multi-drop bus
+#endif
+
+#if RX_TIMESTAMP == ENABLE
+// TMR1H when each byte of read_buffer arrived, at the same index
+unsigned char read_time[BUF_SIZE];
+#endif
+
+#if FRAME_DETECT == ENABLE
+static unsigned int frame_gap_ticks;        // FRAME_GAP in Timer1 ticks
+static volatile bit frame_ended = FALSE;
+#endif
+
+#if BRIDGE == ENABLE
+static volatile bit bridge_active = FALSE;
+static unsigned char bridge_escapes;        // BRIDGE_ESCAPE bytes in a row
+static Serial_port *bridge_sink;
+static void (*bridge_hook)(unsigned char x);
+#if BRIDGE_FILTER == ENABLE
+static unsigned char bridge_filter[32];     // One bit per byte value, set = dropped
+#endif
+#endif
+
+#if LINE_MODE == ENABLE
+// Line index: the save counter value after each line terminator. Written by
+// Serial_ReadISR at line_save_pointer, read by Serial_readLine at line_read_pointer.
+volatile unsigned char line_end[LINE_COUNT];
+volatile unsigned char line_save_pointer = 0;
+volatile unsigned char line_read_pointer = 0;
+#endif
+
+// Read time-out in milliseconds. Timer1 ticks are collected in timeout_ticks and
+// converted to milliseconds, so the 16-bit Timer1 never needs to reach the time-out.
+unsigned int serial_timeout = TIMEOUT;
+static unsigned int timeout_left;
+static unsigned int timeout_ticks;
+static unsigned int timeout_last;
+static bit terminator_found;
+
+// Failure tables for the Serial_find matchers: table[i] is the length of the
+// longest proper prefix of pattern[0..i] that is also a suffix of it.
+static unsigned char target_table[FIND_MAX_LEN];
+static unsigned char terminator_table[FIND_MAX_LEN];
+
+#if RS485 == ENABLE || FLOW_CONTROL != FLOW_NONE
+static void Serial_armCompare(unsigned char characters);
+#endif
+static void Timeout_set(unsigned int timeout);
+static void Timeout_start(void);
+static bit Timeout_expired(void);
+static int Serial_timedPeek(void);
+
+// Next byte without removing it: straight from the buffer, or waits for it
+#define PEEK_NEXT() (Serial.rx_read != Serial.rx_save \
+                        ? (int)read_buffer[Serial.rx_read & BUF_MASK] : Serial_timedPeek())
+
+// Sets the Timer1 times that follow the baud rate, from the SPBRGH:SPBRG value
+// and divider(4, 16 or 64) in use
+static void Serial_setBitTicks(unsigned int brg, unsigned char divider)
+{
+    unsigned char shift;
+
+    // A bit lasts divider*(brg+1) oscillator cycles, that is divider/4*(brg+1) ticks
+    if (divider == 64)
+        shift = 4;
+    else if (divider == 16)
+        shift = 2;
+    else
+        shift = 0;
+    if (brg >= (0xFFFF >> shift))
+        serial_bit_ticks = 0xFFFF;
+    else
+        serial_bit_ticks = (brg + 1) << shift;
+#if FRAME_DETECT == ENABLE
+    // FRAME_GAP tenths of a 10-bit character is FRAME_GAP bit times
+    if ((unsigned long)serial_bit_ticks * FRAME_GAP > 0xFFFF)
+        frame_gap_ticks = 0xFFFF;
+    else
+        frame_gap_ticks = serial_bit_ticks * FRAME_GAP;
+#endif
+}
+
+// Start the Serial port with a given SPBRGH:SPBRG value and divider(4, 16 or 64)
+// Serial_begin(speed) calculates both at compile time.
+void Serial_beginBRG(unsigned int brg, unsigned char divider)
 {
 //    TXSTA: TRANSMIT STATUS AND CONTROL REGISTER
 //    *********************************************
@@ -38,7 +154,7 @@ void Serial_begin(unsigned long baud)
 //Asynchronous mode:
 //1 = High speed
 //0 = Low speed
-    BRGH = 0;
+    BRGH = (divider == 4);
 
 //RCSTA: RECEIVE STATUS AND CONTROL REGISTER
 //    *********************************************
@@ -66,7 +182,7 @@ void Serial_begin(unsigned long baud)
 //    BRG16: 16-bit Baud Rate Generator bit
 //1 = 16-bit Baud Rate Generator is used
 //0 = 8-bit Baud Rate Generator is used
-    BRG16 = 1;
+    BRG16 = (divider != 64);
 //    ABDEN: Auto-Baud Detect Enable bit
 //Asynchronous mode:
 //1 = Auto-Baud Detect mode is enabled (clears when auto-baud is complete)
@@ -74,10 +190,49 @@ void Serial_begin(unsigned long baud)
     ABDEN = 0;
 
 //    The divider value is depends on SYNC, BRGH and BRG16. That can be 64,16 or 4
-    unsigned int divider = 16;
-    unsigned int BaudVal = (_XTAL_FREQ/baud/divider)-1;
-    SPBRGH = (BaudVal & 0xff00) >>  8;
-    SPBRG = BaudVal & 0x00ff;
+    SPBRGH = (brg & 0xff00) >>  8;
+    SPBRG = brg & 0x00ff;
+
+    Serial.rx_save = 0;
+    Serial.rx_read = 0;
+    rx_buffer_dropped = 0;
+#if SERIAL_STATS == ENABLE
+    Serial_resetStats();
+#endif
+
+    Serial_setBitTicks(brg, divider);
+#if RS485 == ENABLE
+    RS485_DE = 0;       // Listen until there is something to send
+    RS485_DE_dir = OUTPUT;
+#endif
+#if FLOW_CONTROL == FLOW_RTSCTS
+    RTS_PIN = 0;        // Ready to receive
+    RTS_dir = OUTPUT;
+    CTS_dir = INPUT;
+#endif
+#if FLOW_CONTROL != FLOW_NONE
+    rx_stopped = FALSE;
+    tx_stopped = FALSE;
+#endif
+#if FLOW_CONTROL == FLOW_XONXOFF
+    flow_char = 0;
+#endif
+#if RS485 == ENABLE || FLOW_CONTROL != FLOW_NONE
+    CCP1IE = 0;
+    CCP1CON = 0b00001010;   // Compare mode, software interrupt on match
+#endif
+#if LINE_MODE == ENABLE
+    line_save_pointer = 0;
+    line_read_pointer = 0;
+#endif
+#if FRAME_DETECT == ENABLE
+    frame_ended = FALSE;
+    CCP2IE = 0;
+    CCP2CON = 0b00001010;   // Compare mode, software interrupt on match
+#endif
+
+    // Time base for the read time-outs
+    Timer_begin();
 
     //Enable interrupts
 //    Clear Flags
@@ -91,44 +246,675 @@ void Serial_begin(unsigned long baud)
 
 }
 
+#if MULTIDROP == ENABLE
+// Start the Serial port as a node of a 9-bit multi-drop bus.
+// Only messages sent to address or BROADCAST_ADDRESS reach the incoming buffer.
+void Serial_beginMultidropBRG(unsigned int brg, unsigned char divider, unsigned char address)
+{
+    Serial_beginBRG(brg, divider);
+    serial_address = address;
+    TX9D = 0;           // Data bytes are sent with the 9th bit clear
+    TX9 = 1;
+    RX9 = 1;
+//    ADDEN: Address Detect Enable bit
+//Asynchronous mode 9-bit (RX9 = 1):
+//1 = Enables address detection, enable interrupt and load the receive buffer when RSR<8> is set
+//0 = Disables address detection, all bytes are received and ninth bit can be used as parity bit
+    ADDEN = 1;
+}
+
+// Sends a message to a node of the multi-drop bus: the address byte with the
+// 9th bit set, then length bytes of buf.
+void Serial_sendTo(unsigned char address, const unsigned char *buf, unsigned char length)
+{
+    // The 9th bit is not queued, so the address goes to TXREG directly once
+    // the previous message has left the outgoing buffer(TXIE is clear then).
+    while (Serial.tx_read != Serial.tx_save)
+        NOP();
+    while (!TXIF);
+#if RS485 == ENABLE
+    CCP1IE = 0;
+    RS485_DE = 1;
+#endif
+    TX9D = 1;
+    TXREG = address;
+    NOP();              // TXIF is updated one cycle after the TXREG write
+    while (!TXIF);      // Address moved to the shift register with its 9th bit
+    TX9D = 0;
+#if RS485 == ENABLE
+    if (length == 0)
+        Serial_armCompare(1);
+#endif
+    while (length--)
+        Serial_write(*buf++);
+}
+#endif
+
+// Start the Serial port at the rate of the host. Waits up to timeout milliseconds
+// for the host to send the sync character 0x55('U') and measures it with the
+// Auto-Baud Detect hardware. Returns the detected baud rate, or 0 if nothing was
+// received in time(call Serial_begin then to fall back to a fixed rate).
+unsigned long Serial_beginAuto(unsigned int timeout)
+{
+    unsigned int brg;
+
+    // Divider 4 gives the finest resolution. In Auto-Baud Detect mode the
+    // BRG counts at Fosc/32, so the 8 bit times of 0x55 leave Fosc/(4*baud)
+    // in SPBRGH:SPBRG, which is the value for this divider.
+    Serial_beginBRG(0, 4);
+    RCIE = 0;           // Keep the sync character out of the incoming buffer
+    ABDOVF = 0;
+    ABDEN = 1;          // Cleared by hardware when the measurement is complete
+    Timeout_set(timeout);
+    while (ABDEN)
+    {
+        // ABDOVF: the rate is too low for the 16-bit counter
+        if (ABDOVF || Timeout_expired())
+        {
+            ABDEN = 0;
+            ABDOVF = 0;
+            RCIE = 1;
+            return 0;
+        }
+    }
+    (void)RCREG;        // Clear RCIF, the byte holds no data
+    brg = ((unsigned int)SPBRGH << 8) | SPBRG;
+    Serial_setBitTicks(brg, 4);     // Serial_beginBRG timed the placeholder rate
+    RCIE = 1;
+    return (unsigned long)_XTAL_FREQ / (4 * ((unsigned long)brg + 1));
+}
+
 // Reads incoming serial data. Returns the first byte of incoming serial data available.
 // Supports byte only.
 unsigned char Serial_read(void)
 {
-    if (rx_buffer_available)
-    {
-        if (rx_buffer_read_pointer == BUF_SIZE)
-            rx_buffer_read_pointer = 0;
-        rx_buffer_available--;
-        return read_buffer[rx_buffer_read_pointer++];
-    }
-    else
+    unsigned char inByte;
+    if (Serial.rx_read == Serial.rx_save)
         return 0;   // No data available
+    inByte = read_buffer[Serial.rx_read & BUF_MASK];
+    Serial.rx_read++;
+    return inByte;
+}
+
+#if RX_TIMESTAMP == ENABLE
+// Reads a byte like Serial_read and stores its arrival time(TMR1H) in time
+unsigned char Serial_readTimed(unsigned char *time)
+{
+    unsigned char inByte;
+    if (Serial.rx_read == Serial.rx_save)
+        return 0;   // No data available
+    inByte = read_buffer[Serial.rx_read & BUF_MASK];
+    *time = read_time[Serial.rx_read & BUF_MASK];
+    Serial.rx_read++;
+    return inByte;
+}
+#endif
+
+#if FRAME_DETECT == ENABLE
+// Marks the end of a frame once the line is silent for FRAME_GAP
+void Serial_GapISR(void)
+{
+    CCP2IF = 0;
+    CCP2IE = 0;
+    frame_ended = TRUE;
+}
+
+// Returns true once for each frame that ended with a silent line
+bit Serial_frameEnded(void)
+{
+    if (!frame_ended)
+        return FALSE;
+    frame_ended = FALSE;
+    return TRUE;
+}
+#endif
+
+// Queues a byte for transmission without waiting.
+// Returns true if the byte is queued, false if the outgoing buffer is full.
+bit Serial_tryWrite(unsigned char x)
+{
+    if ((unsigned char)(Serial.tx_save - Serial.tx_read) == TX_BUF_SIZE)
+        return FALSE;   // Buffer full
+    write_buffer[Serial.tx_save & TX_BUF_MASK] = x;
+    Serial.tx_save++;
+    // Same as Serial_startTx, without the call
+#if SERIAL_STATS == ENABLE
+    if ((unsigned char)(Serial.tx_save - Serial.tx_read) > serial_stats.tx_peak)
+        serial_stats.tx_peak = Serial.tx_save - Serial.tx_read;
+#endif
+#if RS485 == ENABLE
+    RS485_DE = 1;       // Take the bus, cancel a pending release
+    CCP1IE = 0;
+#endif
+    TXIE = 1;           // Serial_WriteISR drains the buffer
+    return TRUE;
+}
+
+// Starts the transmitter after SerialPort_tryWrite queued a byte
+static void Serial_startTx(void)
+{
+#if SERIAL_STATS == ENABLE
+    if ((unsigned char)(Serial.tx_save - Serial.tx_read) > serial_stats.tx_peak)
+        serial_stats.tx_peak = Serial.tx_save - Serial.tx_read;
+#endif
+#if RS485 == ENABLE
+    RS485_DE = 1;
+    CCP1IE = 0;
+#endif
+    TXIE = 1;
 }
 
 // Writes binary data to the serial port. Supports single byte only.
+// The byte is queued in the outgoing buffer; waits only if the buffer is full.
 void Serial_write(unsigned char x)
 {
-        while (!TRMT);
-        TXREG =  x;
+    while (!Serial_tryWrite(x))
+        NOP();
+}
+
+// Number of bytes that can be written without waiting
+unsigned char Serial_availableForWrite(void)
+{
+    return TX_BUF_SIZE - (unsigned char)(Serial.tx_save - Serial.tx_read);
 }
 
 //Prints data to the serial port. Supports Strings only.
 void Serial_print(unsigned char *str)
 {
      while(*str)
-     {
-        while (!TRMT);
-        TXREG =  *str++;
-     }
+        Serial_write(*str++);
+}
+
+// Prints a string from program memory(const) without copying it to RAM first.
+void Serial_printConst(const unsigned char *str)
+{
+     while(*str)
+        Serial_write(*str++);
 }
+
+// Number formatting without division(the PIC16 has no divide instruction).
+// Decimal digits are found by subtracting powers of ten, the other bases by
+// shifting out groups of bits.
+const unsigned long powers_of_ten[10] = {
+    1000000000, 100000000, 10000000, 1000000, 100000,
+    10000, 1000, 100, 10, 1
+};
+const unsigned char hex_digits[16] = "0123456789ABCDEF";
+
+// Prints value in decimal with a '.' before the last decimals digits(0 for none)
+static void Print_decimal(unsigned long value, unsigned char decimals)
+{
+    unsigned char position;
+    unsigned char remaining = 10;   // Digits left including this one
+    unsigned char digit;
+    unsigned char started = FALSE;
+
+    if (decimals > 9)
+        decimals = 9;
+    for (position = 0; position < 10; position++)
+    {
+        remaining--;
+        digit = '0';
+        while (value >= powers_of_ten[position])
+        {
+            value -= powers_of_ten[position];
+            digit++;
+        }
+        // Leading zeros are skipped up to the units digit
+        if (digit != '0' || started || remaining <= decimals)
+        {
+            started = TRUE;
+            Serial_write(digit);
+            if (decimals && remaining == decimals)
+                Serial_write('.');
+        }
+    }
+}
+
+// Prints value in base 2^bits(1, 3 or 4) with leading zeros up to digits
+static void Print_shifted(unsigned long value, unsigned char bits, unsigned char digits)
+{
+    unsigned char shift;
+    unsigned char remaining;        // Digits left including this one
+    unsigned char digit;
+    unsigned char started = FALSE;
+
+    switch (bits)
+    {
+        case 1:
+            shift = 31;
+            remaining = 32;
+            break;
+        case 3:
+            shift = 30;
+            remaining = 11;
+            break;
+        default:
+            shift = 28;
+            remaining = 8;
+    }
+    while (remaining)
+    {
+        digit = (unsigned char)(value >> shift) & ((1 << bits) - 1);
+        if (digit || started || remaining <= digits || remaining == 1)
+        {
+            started = TRUE;
+            Serial_write(hex_digits[digit]);
+        }
+        shift -= bits;
+        remaining--;
+    }
+}
+
+// Prints an integer in base 2, 8, 10 or 16(other bases print in 10). Negative
+// numbers get a '-' in base 10 only, like Arduino's Serial.print(value, base).
+void Serial_printInt(long value, unsigned char base)
+{
+    switch (base)
+    {
+        case 2:
+            Print_shifted(value, 1, 0);
+            break;
+        case 8:
+            Print_shifted(value, 3, 0);
+            break;
+        case 16:
+            Print_shifted(value, 4, 0);
+            break;
+        default:
+            Serial_printFixed(value, 0);
+    }
+}
+
+// Prints an unsigned number in hexadecimal, with leading zeros up to digits.
+void Serial_printHex(unsigned long value, unsigned char digits)
+{
+    Print_shifted(value, 4, digits);
+}
+
+// Prints value/10^decimals as a fixed point number. eg:- (1234, 2) prints 12.34
+void Serial_printFixed(long value, unsigned char decimals)
+{
+    if (value < 0)
+    {
+        Serial_write('-');
+        value = -value;
+    }
+    Print_decimal((unsigned long)value, decimals);
+}
+
+// Prints formatted text. Supports %c %s %d %i %u %x %X %ld %li %lu %lx %lX and %%.
+void Serial_printf(const char *format, ...)
+{
+    va_list ap;
+    unsigned char is_long;
+    unsigned long value;
+
+    va_start(ap, format);
+    while (*format)
+    {
+        if (*format != '%')
+        {
+            Serial_write(*format++);
+            continue;
+        }
+        format++;
+        is_long = (*format == 'l');
+        if (is_long)
+            format++;
+        switch (*format)
+        {
+            case 'c':
+                Serial_write(va_arg(ap, int));
+                break;
+            case 's':
+                Serial_print(va_arg(ap, unsigned char *));
+                break;
+            case 'd':
+            case 'i':
+                Serial_printFixed(is_long ? va_arg(ap, long) : va_arg(ap, int), 0);
+                break;
+            case 'u':
+                Print_decimal(is_long ? va_arg(ap, unsigned long) : va_arg(ap, unsigned int), 0);
+                break;
+            case 'x':
+            case 'X':
+                value = is_long ? va_arg(ap, unsigned long) : va_arg(ap, unsigned int);
+                Print_shifted(value, 4, 0);
+                break;
+            case 0:
+                continue;       // '%' at the end of the format
+            default:
+                Serial_write(*format);
+        }
+        format++;
+    }
+    va_end(ap);
+}
+
+// Moves the next queued byte to TXREG. TXIF is set as soon as TXREG is free,
+// so the next byte is loaded while the previous one is still shifting out.
+void Serial_WriteISR(void)
+{
+#if RS485 == ENABLE
+    unsigned char shifting = !TRMT; // TXREG waits behind a byte in the shift register
+#endif
+#if FLOW_CONTROL == FLOW_XONXOFF
+    // XON/XOFF go ahead of the queued data and are sent even when stopped
+    if (flow_char)
+    {
+        TXREG = flow_char;
+        flow_char = 0;
+        if (tx_stopped || Serial.tx_read == Serial.tx_save)
+            TXIE = 0;
+        return;
+    }
+#endif
+#if FLOW_CONTROL == FLOW_RTSCTS
+    if (CTS_PIN)
+        tx_stopped = TRUE;      // Serial_CompareISR restarts when CTS is back
+#endif
+    // TXIE does not mean data is queued: Serial_tryWrite sets it after tx_save++,
+    // so this ISR may already have sent that byte and emptied the queue.
+#if FLOW_CONTROL != FLOW_NONE
+    if (tx_stopped || Serial.tx_read == Serial.tx_save)
+#else
+    if (Serial.tx_read == Serial.tx_save)
+#endif
+    {
+        TXIE = 0;
+#if FLOW_CONTROL == FLOW_RTSCTS
+        if (tx_stopped && !CCP1IE)
+            Serial_armCompare(1);
+#endif
+#if RS485 == ENABLE
+        if (!CCP1IE)    // The writer cancelled the release of the last byte
+            Serial_armCompare(shifting ? 2 : 1);
+#endif
+        return;
+    }
+    TXREG = write_buffer[Serial.tx_read & TX_BUF_MASK];
+    Serial.tx_read++;
+#if SERIAL_STATS == ENABLE
+    serial_stats.tx_bytes++;
+#endif
+    if (Serial.tx_read == Serial.tx_save)
+    {
+        TXIE = 0;       // Nothing left to send
+#if RS485 == ENABLE
+        // The last byte is done in one character time, or two if it has to
+        // wait for the shift register. Serial_CompareISR checks TRMT then.
+        Serial_armCompare(shifting ? 2 : 1);
+#endif
+    }
+}
+
+#if RS485 == ENABLE || FLOW_CONTROL != FLOW_NONE
+// Schedules Serial_CompareISR after the given number of characters(10 bits,
+// 11 with 9-bit mode), using CCP1 compare on Timer1. RS485_GUARD is added for RS485.
+static void Serial_armCompare(unsigned char characters)
+{
+    unsigned int ticks = serial_bit_ticks * (TX9 ? 11 : 10);
+    if (characters == 2)
+        ticks += ticks;
+#if RS485 == ENABLE
+    ticks += RS485_GUARD;
+#endif
+    ticks += Timer_ticks();
+    CCP1IE = 0;
+    CCPR1H = ticks >> 8;
+    CCPR1L = ticks & 0xff;
+    CCP1IF = 0;
+    CCP1IE = 1;
+}
+
+#if RS485 == ENABLE
+// Releases the bus when the outgoing buffer and the shift register are empty.
+// If the last byte is still shifting out, checks again one bit time later.
+void Serial_CompareISR(void)
+{
+    unsigned int ticks;
+    CCP1IF = 0;
+    if (Serial.tx_read != Serial.tx_save)
+    {
+        CCP1IE = 0;     // More data queued, Serial_WriteISR arms again
+        return;
+    }
+    if (!TXIF || !TRMT)
+    {
+        ticks = Timer_ticks() + serial_bit_ticks;
+        CCPR1H = ticks >> 8;
+        CCPR1L = ticks & 0xff;
+        return;
+    }
+    RS485_DE = 0;
+    CCP1IE = 0;
+}
+#else
+// Checks once per character time while the flow is stopped: restarts the sender
+// when the incoming buffer is down to FLOW_LOW, and the transmitter when CTS is back.
+void Serial_CompareISR(void)
+{
+    unsigned char again = FALSE;
+    CCP1IF = 0;
+    if (rx_stopped)
+    {
+        if ((unsigned char)(Serial.rx_save - Serial.rx_read) <= FLOW_LOW)
+        {
+            rx_stopped = FALSE;
+#if FLOW_CONTROL == FLOW_RTSCTS
+            RTS_PIN = 0;
+#else
+            flow_char = XON;
+            TXIE = 1;
+#endif
+        }
+        else
+            again = TRUE;
+    }
+#if FLOW_CONTROL == FLOW_RTSCTS
+    if (tx_stopped)
+    {
+        if (!CTS_PIN)
+        {
+            tx_stopped = FALSE;
+            if (Serial.tx_read != Serial.tx_save)
+                TXIE = 1;
+        }
+        else
+            again = TRUE;
+    }
+#endif
+    if (again)
+        Serial_armCompare(1);
+    else
+        CCP1IE = 0;
+}
+#endif
+#endif
+// Moves received bytes to the incoming buffer. Both bytes of the receive FIFO
+// are drained in one call. RCIF is cleared by reading RCREG.
 void Serial_ReadISR(void)
 {
-    if (rx_buffer_save_pointer == BUF_SIZE)
-        rx_buffer_save_pointer = 0;
-    read_buffer[rx_buffer_save_pointer++] = RCREG;
-    rx_buffer_available++;
-    RCIF = 0;
+    unsigned char inByte;
+#if ISR_TIMING == ENABLE || (BRIDGE == ENABLE && SERIAL_STATS == ENABLE)
+    unsigned int start = Timer_ticks();
+#endif
+#if ISR_TIMING == ENABLE
+    unsigned char count = 0;
+#endif
+    while (RCIF)
+    {
+#if SERIAL_STATS == ENABLE
+        serial_stats.rx_bytes++;
+#endif
+#if ISR_TIMING == ENABLE
+        count++;
+#endif
+        if (FERR)
+        {
+            inByte = RCREG;     // Discard the byte with a framing error
+            rx_buffer_dropped++;
+#if SERIAL_STATS == ENABLE
+            serial_stats.framing_errors++;
+#endif
+            continue;
+        }
+#if MULTIDROP == ENABLE
+        if (RX9D)
+        {
+            // Address byte: take the message if it is for this node. ADDEN set
+            // again keeps the data of other nodes' messages out of the ISR.
+            inByte = RCREG;
+            ADDEN = (inByte != serial_address && inByte != BROADCAST_ADDRESS);
+            continue;
+        }
+#endif
+        inByte = RCREG;
+#if FLOW_CONTROL == FLOW_XONXOFF
+        if (inByte == XOFF)
+        {
+            tx_stopped = TRUE;
+            continue;
+        }
+        if (inByte == XON)
+        {
+            tx_stopped = FALSE;
+            if (Serial.tx_read != Serial.tx_save)
+                TXIE = 1;
+            continue;
+        }
+#endif
+#if BRIDGE == ENABLE
+        if (bridge_active)
+        {
+            // A hook gets every byte and ends the bridge itself
+            if (!bridge_hook)
+            {
+                if (inByte != BRIDGE_ESCAPE)
+                    bridge_escapes = 0;
+                else if (++bridge_escapes == BRIDGE_ESCAPE_COUNT)
+                    bridge_active = FALSE;  // This byte is the last one forwarded
+            }
+#if BRIDGE_FILTER == ENABLE
+            if (bridge_filter[inByte >> 3] & (1 << (inByte & 7)))
+                continue;
+#endif
+            if (bridge_hook)
+                bridge_hook(inByte);
+            else if ((unsigned char)(bridge_sink->tx_save - bridge_sink->tx_read) > bridge_sink->tx_mask)
+            {
+                rx_buffer_dropped++;    // Sink full
+#if SERIAL_STATS == ENABLE
+                serial_stats.overflows++;
+#endif
+                continue;
+            }
+            else
+            {
+                // The ISR of the sink picks the byte up; only the hardware
+                // port has to be started.
+                bridge_sink->tx_buffer[bridge_sink->tx_save & bridge_sink->tx_mask] = inByte;
+                bridge_sink->tx_save++;
+                if (bridge_sink == &Serial)
+                {
+#if RS485 == ENABLE
+                    RS485_DE = 1;
+                    CCP1IE = 0;
+#endif
+                    TXIE = 1;
+                }
+            }
+#if SERIAL_STATS == ENABLE
+            serial_stats.bridge_bytes++;
+            {
+                unsigned int ticks = (unsigned short)(Timer_ticks() - start);
+                serial_stats.bridge_total += ticks;
+                if (ticks > serial_stats.bridge_max)
+                    serial_stats.bridge_max = ticks;
+            }
+#endif
+            continue;
+        }
+#endif
+        if ((unsigned char)(Serial.rx_save - Serial.rx_read) == BUF_SIZE)
+        {
+            rx_buffer_dropped++;    // Buffer full, keep the unread data
+#if SERIAL_STATS == ENABLE
+            serial_stats.overflows++;
+#endif
+            continue;
+        }
+        read_buffer[Serial.rx_save & BUF_MASK] = inByte;
+#if RX_TIMESTAMP == ENABLE
+        read_time[Serial.rx_save & BUF_MASK] = TMR1H;
+#endif
+        Serial.rx_save++;
+#if SERIAL_STATS == ENABLE
+        if ((unsigned char)(Serial.rx_save - Serial.rx_read) > serial_stats.rx_peak)
+            serial_stats.rx_peak = Serial.rx_save - Serial.rx_read;
+#endif
+#if FLOW_CONTROL != FLOW_NONE
+        if (!rx_stopped
+            && (unsigned char)(Serial.rx_save - Serial.rx_read) >= FLOW_HIGH)
+        {
+            rx_stopped = TRUE;  // Serial_CompareISR restarts the sender
+#if FLOW_CONTROL == FLOW_RTSCTS
+            RTS_PIN = 1;
+#else
+            flow_char = XOFF;
+            TXIE = 1;
+#endif
+            if (!CCP1IE)
+                Serial_armCompare(1);
+        }
+#endif
+#if LINE_MODE == ENABLE
+        // With the index full, the line is joined to the next one. A line that
+        // fills the whole buffer is ended here without its terminator, or
+        // Serial_readLine could never make room for the rest of it.
+        if ((inByte == LINE_TERMINATOR
+             && (unsigned char)(line_save_pointer - line_read_pointer) != LINE_COUNT)
+            || ((unsigned char)(Serial.rx_save - Serial.rx_read) == BUF_SIZE
+                && line_save_pointer == line_read_pointer))
+        {
+            line_end[line_save_pointer & LINE_MASK] = Serial.rx_save;
+            line_save_pointer++;
+        }
+#endif
+    }
+#if FRAME_DETECT == ENABLE
+    // Serial_GapISR runs unless another byte comes within FRAME_GAP
+    {
+        unsigned int ticks = Timer_ticks() + frame_gap_ticks;
+        CCP2IE = 0;
+        CCPR2H = ticks >> 8;
+        CCPR2L = ticks & 0xff;
+        CCP2IF = 0;
+        CCP2IE = 1;
+    }
+#endif
+    // Overrun: the receiver stops until CREN is toggled
+    if (OERR)
+    {
+        CREN = 0;
+        CREN = 1;
+        rx_buffer_dropped++;
+#if SERIAL_STATS == ENABLE
+        serial_stats.overruns++;
+#endif
+    }
+#if ISR_TIMING == ENABLE
+    // Ticks per byte; the FIFO gives at most two bytes per call
+    start = (unsigned short)(Timer_ticks() - start);
+    serial_stats.isr_total += start;
+    if (count > 1)
+        start >>= 1;
+    if (start < serial_stats.isr_min)
+        serial_stats.isr_min = start;
+    if (start > serial_stats.isr_max)
+        serial_stats.isr_max = start;
+#endif
 }
 // Prints data to the serial port as human-readable ASCII text followed by a carriage
 // return character (ASCII 13, or '\r') and a newline character (ASCII 10, or '\n').
@@ -136,17 +922,147 @@ void Serial_ReadISR(void)
 void Serial_println(unsigned char *str)
 {
     Serial_print(str);
-    while (!TRMT);
-    TXREG =  CR;
-    while (!TRMT);
-    TXREG =  LF;
+    Serial_write(CR);
+    Serial_write(LF);
 }
 
 
 // Number of available data bytes
 unsigned char Serial_available(void)
 {
-    return rx_buffer_available;
+    return (unsigned char)(Serial.rx_save - Serial.rx_read);
+}
+
+#if SERIAL_STATS == ENABLE
+// Copies the link counters to stats. Interrupts are held off during the copy,
+// so the snapshot is consistent.
+void Serial_getStats(Serial_stats *stats)
+{
+    GIE = 0;
+    *stats = serial_stats;
+    GIE = 1;
+}
+
+// Clears the link counters
+void Serial_resetStats(void)
+{
+    GIE = 0;
+    serial_stats.rx_bytes = 0;
+    serial_stats.tx_bytes = 0;
+    serial_stats.overflows = 0;
+    serial_stats.overruns = 0;
+    serial_stats.framing_errors = 0;
+    serial_stats.rx_peak = 0;
+    serial_stats.tx_peak = 0;
+#if ISR_TIMING == ENABLE
+    serial_stats.isr_min = 0xFFFF;
+    serial_stats.isr_max = 0;
+    serial_stats.isr_total = 0;
+#endif
+#if BRIDGE == ENABLE
+    serial_stats.bridge_bytes = 0;
+    serial_stats.bridge_max = 0;
+    serial_stats.bridge_total = 0;
+#endif
+    GIE = 1;
+}
+#endif
+
+#if BRIDGE == ENABLE
+// Forwards every received byte from Serial_ReadISR to sink, or to hook when it
+// is not 0, until the escape sequence or Serial_bridgeEnd.
+void Serial_bridge(Serial_port *sink, void (*hook)(unsigned char x))
+{
+    GIE = 0;
+    bridge_sink = sink;
+    bridge_hook = hook;
+    bridge_escapes = 0;
+    bridge_active = TRUE;
+    GIE = 1;
+}
+
+// Ends the bridge
+void Serial_bridgeEnd(void)
+{
+    bridge_active = FALSE;
+}
+
+// Returns true while the bridge forwards the received bytes
+bit Serial_bridgeActive(void)
+{
+    return bridge_active;
+}
+
+#if BRIDGE_FILTER == ENABLE
+// Drops x in the bridge(pass = FALSE) or forwards it again(pass = TRUE)
+void Serial_bridgeFilter(unsigned char x, unsigned char pass)
+{
+    unsigned char mask = 1 << (x & 7);
+    GIE = 0;
+    if (pass)
+        bridge_filter[x >> 3] &= ~mask;
+    else
+        bridge_filter[x >> 3] |= mask;
+    GIE = 1;
+}
+#endif
+#endif
+
+#if LINE_MODE == ENABLE
+// Number of complete lines waiting
+unsigned char Serial_lineAvailable(void)
+{
+    return (unsigned char)(line_save_pointer - line_read_pointer);
+}
+
+// Copies the next complete line into buffer without the line ending and adds a
+// 0 terminator. Characters that do not fit in length-1 are discarded.
+// Returns the number of characters placed in the buffer.
+unsigned char Serial_readLine(unsigned char buffer[], unsigned char length)
+{
+    unsigned char index = Serial.rx_read;
+    unsigned char next;
+    unsigned char end;
+    unsigned char count = 0;
+    unsigned char inByte;
+
+    // Skip line ends already passed by Serial_read and the other read functions.
+    // A line end holds at least its terminator, so one at index is passed too.
+    while (line_read_pointer != line_save_pointer
+           && (unsigned char)(line_end[line_read_pointer & LINE_MASK] - index - 1)
+              >= (unsigned char)(Serial.rx_save - index))
+        line_read_pointer++;
+    if (line_read_pointer == line_save_pointer || length == 0)
+        return 0;
+    next = line_end[line_read_pointer & LINE_MASK];
+    end = next;
+    if (end != index && read_buffer[(end - 1) & BUF_MASK] == LINE_TERMINATOR)
+        end--;                                              // Leave out the terminator
+    length--;                                               // Room for the 0
+    while (index != end)
+    {
+        inByte = read_buffer[index & BUF_MASK];
+        index++;
+        if (count < length)
+            buffer[count++] = inByte;
+    }
+    if (LINE_TERMINATOR == LF && count && buffer[count - 1] == CR)
+        count--;
+    buffer[count] = 0;
+    Serial.rx_read = next;
+    line_read_pointer++;
+    return count;
+}
+#endif
+
+// Number of received bytes lost since Serial_begin (buffer full, overrun or framing error)
+unsigned int Serial_dropCount(void)
+{
+    unsigned int count;
+    RCIE = 0;           // The counter is 16-bit, keep the ISR out while reading
+    count = rx_buffer_dropped;
+    RCIE = 1;
+    return count;
 }
 
 
@@ -154,28 +1070,261 @@ unsigned char Serial_available(void)
 // Stop Serial port(Pins will be available for generic use)
 void Serial_end(void);
 
-// Read data from serial buffer until the target string of given length is found.
+// Builds the failure table of a non-empty pattern and returns its length,
+// limited to FIND_MAX_LEN.
+static unsigned char Find_prepare(const unsigned char *pattern, unsigned char table[])
+{
+    unsigned char length = 1;
+    unsigned char state = 0;
+    table[0] = 0;
+    while (pattern[length] && length < FIND_MAX_LEN)
+    {
+        while (state && pattern[length] != pattern[state])
+            state = table[state - 1];
+        if (pattern[length] == pattern[state])
+            state++;
+        table[length++] = state;
+    }
+    return length;
+}
+
+// Feeds one byte to a matcher and returns the new number of matched characters.
+// Falls back through the failure table, so no byte is ever scanned twice.
+static unsigned char Find_step(const unsigned char *pattern, const unsigned char table[],
+                               unsigned char state, unsigned char inByte)
+{
+    while (state && inByte != pattern[state])
+        state = table[state - 1];
+    if (inByte == pattern[state])
+        state++;
+    return state;
+}
+
+// Read data from serial buffer until the target string is found.
 // The function returns true if target string is found, false if it times out.
-bit Serial_find(unsigned char str)
+// Only the first FIND_MAX_LEN characters of the target are matched.
+bit Serial_find(const unsigned char *target)
 {
-    return 0;
+    return Serial_findUntil(target, 0);
 }
 
 
-// Reads data from the serial buffer until a target string of given length or
-// terminator string is found. The function returns true if the target
-// string is found, false if it times out.
-bit Serial_findUntil(unsigned char str, unsigned char terminator)
+// Reads data from the serial buffer until a target string or terminator
+// string is found. The function returns true if the target string is found,
+// false if the terminator is found or it times out. terminator may be 0.
+// The bytes are matched in place in the incoming buffer as they arrive and
+// are consumed up to the end of the match.
+bit Serial_findUntil(const unsigned char *target, const unsigned char *terminator)
 {
-    return 0;
+    unsigned char target_length;
+    unsigned char target_state = 0;
+    unsigned char terminator_length = 0;
+    unsigned char terminator_state = 0;
+    unsigned char index;
+    unsigned char inByte;
+
+    if (*target == 0)
+        return TRUE;
+    target_length = Find_prepare(target, target_table);
+    if (terminator && *terminator)
+        terminator_length = Find_prepare(terminator, terminator_table);
+
+    Timeout_start();
+    while (1)
+    {
+        index = Serial.rx_read;
+        if (index == Serial.rx_save)
+        {
+            if (Timeout_expired())
+                return FALSE;
+            continue;
+        }
+        while (index != Serial.rx_save)
+        {
+            inByte = read_buffer[index & BUF_MASK];
+            index++;
+            target_state = Find_step(target, target_table, target_state, inByte);
+            if (target_state == target_length)
+            {
+                Serial.rx_read = index;
+                return TRUE;
+            }
+            if (terminator_length)
+            {
+                terminator_state = Find_step(terminator, terminator_table, terminator_state, inByte);
+                if (terminator_state == terminator_length)
+                {
+                    Serial.rx_read = index;
+                    return FALSE;
+                }
+            }
+        }
+        Serial.rx_read = index;
+        Timeout_start();
+    }
 }
 
-//Waits for the transmission of outgoing serial data to complete.
+//Waits for the transmission of outgoing serial data to complete. Returns when
+//the outgoing buffer is empty and the last stop bit has left the shift register.
 void Serial_flush(void)
 {
-    rx_buffer_save_pointer = 0;   // This is a circular buffer save counter.
-    rx_buffer_read_pointer = 0;   // This is a circular buffer read counter.
-    rx_buffer_available = 0; //The available bytes in the buffer. Countable backwards from rx_buffer_save_pointer
+    while (Serial.tx_read != Serial.tx_save)
+        NOP();
+    Serial_waitTx();
+}
+
+// Waits for the last byte to leave the transmitter once the outgoing buffer is empty
+static void Serial_waitTx(void)
+{
+    while (!TXIF);      // Last byte moved from TXREG to the shift register
+    while (!TRMT);      // Shift register empty
+#if RS485 == ENABLE
+    while (RS485_DE);   // Bus released by Serial_CompareISR
+#endif
+}
+
+/*******************************************************************************
+* Functions for any port(see SerialPort_ in serial.h)
+*******************************************************************************/
+
+// Number of available data bytes
+unsigned char Port_available(Serial_port *port)
+{
+    return (unsigned char)(port->rx_save - port->rx_read);
+}
+
+// Returns the next received byte, 0 if there is none
+unsigned char Port_read(Serial_port *port)
+{
+    unsigned char inByte;
+    if (port->rx_read == port->rx_save)
+        return 0;   // No data available
+    inByte = port->rx_buffer[port->rx_read & port->rx_mask];
+    port->rx_read++;
+    return inByte;
+}
+
+// Queues a byte without waiting. Returns false if the outgoing buffer is full.
+bit Port_tryWrite(Serial_port *port, unsigned char x)
+{
+    if ((unsigned char)(port->tx_save - port->tx_read) > port->tx_mask)
+        return FALSE;   // Buffer full
+    port->tx_buffer[port->tx_save & port->tx_mask] = x;
+    port->tx_save++;
+    port->start_tx();
+    return TRUE;
+}
+
+// Queues a byte, waits only if the outgoing buffer is full
+void Port_write(Serial_port *port, unsigned char x)
+{
+    while (!Port_tryWrite(port, x))
+        NOP();
+}
+
+// Prints a string
+void Port_print(Serial_port *port, unsigned char *str)
+{
+    while(*str)
+        Port_write(port, *str++);
+}
+
+// Prints a string followed by CR and LF
+void Port_println(Serial_port *port, unsigned char *str)
+{
+    Port_print(port, str);
+    Port_write(port, CR);
+    Port_write(port, LF);
+}
+
+// Waits until the outgoing buffer is empty and the last byte has been sent
+void Port_flush(Serial_port *port)
+{
+    while (port->tx_read != port->tx_save)
+        NOP();
+    port->wait_tx();
+}
+
+// Sets the maximum milliseconds to wait for the next byte in the read functions.
+void Serial_setTimeout(unsigned int timeout)
+{
+    serial_timeout = timeout;
+}
+
+// Starts a time-out of the given milliseconds
+static void Timeout_set(unsigned int timeout)
+{
+    timeout_left = timeout;
+    timeout_ticks = 0;
+    timeout_last = Timer_ticks();
+}
+
+// Restarts the read time-out
+static void Timeout_start(void)
+{
+    Timeout_set(serial_timeout);
+}
+
+// Returns true once the read time-out has elapsed since Timeout_start.
+// Must be called more often than every 65536 ticks(32ms at 8MHz).
+static bit Timeout_expired(void)
+{
+    unsigned int now = Timer_ticks();
+    timeout_ticks += (unsigned short)(now - timeout_last);
+    timeout_last = now;
+    while (timeout_ticks >= TICKS_PER_MS)
+    {
+        timeout_ticks -= TICKS_PER_MS;
+        if (timeout_left)
+            timeout_left--;
+    }
+    return timeout_left == 0;
+}
+
+// Copies the bytes already in the incoming buffer to buffer[], up to length bytes
+// or until the terminator(-1 for none) is found. The read counter is updated once
+// for the whole run instead of once per byte.
+static unsigned char Serial_copyRun(unsigned char buffer[], unsigned char length, int terminator)
+{
+    unsigned char index = Serial.rx_read;
+    unsigned char end = Serial.rx_save;
+    unsigned char count = 0;
+    unsigned char inByte;
+    while (index != end && count < length)
+    {
+        inByte = read_buffer[index & BUF_MASK];
+        index++;
+        if (inByte == terminator)
+        {
+            terminator_found = TRUE;
+            break;
+        }
+        buffer[count++] = inByte;
+    }
+    Serial.rx_read = index;
+    return count;
+}
+
+// Common part of Serial_readBytes and Serial_readBytesUntil. The time-out is
+// restarted whenever new data is copied.
+static unsigned char Serial_readUntil(int terminator, unsigned char buffer[], unsigned char length)
+{
+    unsigned char count = 0;
+    terminator_found = FALSE;
+    Timeout_start();
+    while (count < length)
+    {
+        if (Serial.rx_read != Serial.rx_save)
+        {
+            count += Serial_copyRun(buffer + count, length - count, terminator);
+            if (terminator_found)
+                break;
+            Timeout_start();
+        }
+        else if (Timeout_expired())
+            break;
+    }
+    return count;
 }
 
 // Reads characters from the serial port into a buffer. The function terminates
@@ -183,14 +1332,101 @@ void Serial_flush(void)
 // Returns the number of characters placed in the buffer. A 0 means no valid data was found.
 unsigned char Serial_readBytes(unsigned char buffer[], unsigned char length)
 {
-    return 0;
+    return Serial_readUntil(-1, buffer, length);
 }
 
 // Reads characters from the serial buffer into an array. The function terminates
 // if the terminator character is detected, the determined length has been read, or it times out.
+// The terminator is removed from the buffer but not stored.
 // Returns the number of characters placed in the buffer. A 0 means no valid data was found.
 unsigned char Serial_readBytesUntil(unsigned char str, unsigned char buffer[], unsigned char length)
 {
-    return 0;
+    return Serial_readUntil(str, buffer, length);
+}
+
+// Same as Serial_readBytesUntil, but ends buffer with a 0
+unsigned char Serial_readStringUntil(unsigned char terminator, unsigned char buffer[], unsigned char length)
+{
+    unsigned char count;
+    if (length == 0)
+        return 0;
+    count = Serial_readUntil(terminator, buffer, length - 1);
+    buffer[count] = 0;
+    return count;
+}
+
+// Returns the next byte without removing it from the buffer, or -1 if there is none.
+int Serial_peek(void)
+{
+    if (Serial.rx_read == Serial.rx_save)
+        return -1;
+    return read_buffer[Serial.rx_read & BUF_MASK];
+}
+
+// Waits up to the time-out for a byte and returns it without removing it, or -1
+static int Serial_timedPeek(void)
+{
+    Timeout_start();
+    while (Serial.rx_read == Serial.rx_save)
+    {
+        if (Timeout_expired())
+            return -1;
+    }
+    return read_buffer[Serial.rx_read & BUF_MASK];
+}
+
+// Skips bytes up to the first digit or minus sign(or decimal point).
+// Returns it without removing it, or -1 on time-out.
+static int Serial_peekNextDigit(unsigned char decimal)
+{
+    int c;
+    while (1)
+    {
+        c = PEEK_NEXT();
+        if (c < 0 || c == '-' || (c >= '0' && c <= '9') || (decimal && c == '.'))
+            return c;
+        Serial.rx_read++;
+    }
+}
+
+// Returns the next integer, 0 if no digit comes within the time-out
+long Serial_parseInt(void)
+{
+    return Serial_parseFixed(0);
 }
 
+// Returns the next number with one decimal point, scaled by 10^decimals
+long Serial_parseFixed(unsigned char decimals)
+{
+    long value = 0;
+    unsigned char negative = FALSE;
+    unsigned char fraction = FALSE;
+    unsigned char places = 0;
+    int c = Serial_peekNextDigit(decimals != 0);
+
+    if (c < 0)
+        return 0;
+    do
+    {
+        if (c == '-')
+            negative = TRUE;
+        else if (c == '.')
+            fraction = TRUE;
+        else if (!fraction)
+            value = value * 10 + (c - '0');
+        else if (places < decimals)
+        {
+            value = value * 10 + (c - '0');
+            places++;
+        }
+        Serial.rx_read++;
+        c = PEEK_NEXT();
+    } while ((c >= '0' && c <= '9') || (c == '.' && decimals && !fraction));
+
+    while (places < decimals)
+    {
+        value *= 10;
+        places++;
+    }
+    return negative ? -value : value;
+}
@@ -19,12 +19,183 @@ extern char temp10;
 /*******************************************************************************
 * PRIVATE CONSTANTS                                                            *
 *******************************************************************************/
-//Set the time-out for serial data read in seconds
-#define TIMEOUT         10
+//Default time-out for serial data read in milliseconds(see Serial_setTimeout)
+#define TIMEOUT         1000
 
-//Defined size for incoming buffer
+//Defined size for incoming buffer. Must be a power of two, 128 at most.
 #define BUF_SIZE        64
 
+//Defined size for outgoing buffer. Must be a power of two, 128 at most.
+#define TX_BUF_SIZE     32
+
+//Longest target/terminator string for Serial_find and Serial_findUntil
+#define FIND_MAX_LEN    16
+
+//Line mode: Serial_ReadISR records where each line ends, so complete lines can
+//be checked with Serial_lineAvailable and taken with Serial_readLine.
+#define LINE_MODE       DISABLE
+//Character that ends a line in line mode(a CR before it is removed too)
+#define LINE_TERMINATOR LF
+//Complete lines that can be waiting. Must be a power of two.
+#define LINE_COUNT      4
+
+//9-bit multi-drop mode(Serial_beginMultidrop). Address bytes have the 9th bit set
+//and the EUSART address detection keeps other nodes' data out of the ISR.
+#define MULTIDROP       DISABLE
+//Address every node accepts in multi-drop mode
+#define BROADCAST_ADDRESS   0xFF
+
+//RS-485 half-duplex: RS485_DE drives the DE and /RE pins of the transceiver. It is
+//set when transmission starts and cleared by interrupt(CCP1 compare on Timer1)
+//when the last stop bit has left the shift register. Needs 1200 baud or more at 8MHz.
+#define RS485           DISABLE
+#define RS485_DE        RC5
+#define RS485_DE_dir    TRISC5
+//Time the bus is held after the last stop bit, in Timer1 ticks(instruction cycles)
+#define RS485_GUARD     0
+
+//Flow control: FLOW_NONE, FLOW_RTSCTS(hardware) or FLOW_XONXOFF(software).
+//The sender is stopped when the incoming buffer holds FLOW_HIGH bytes and
+//restarted when it is down to FLOW_LOW. Not available with RS485.
+#define FLOW_NONE       0
+#define FLOW_RTSCTS     1
+#define FLOW_XONXOFF    2
+#define FLOW_CONTROL    FLOW_NONE
+#define FLOW_HIGH       (BUF_SIZE - 16)
+#define FLOW_LOW        (BUF_SIZE / 4)
+//RTS output and CTS input, both active low(0 = ready to receive)
+#define RTS_PIN         RC4
+#define RTS_dir         TRISC4
+#define CTS_PIN         RC3
+#define CTS_dir         TRISC3
+#define XON             0x11
+#define XOFF            0x13
+
+//Link counters for Serial_getStats
+#define SERIAL_STATS    ENABLE
+//Timer1 measurement of Serial_ReadISR in Serial_getStats(needs SERIAL_STATS)
+#define ISR_TIMING      DISABLE
+
+//Arrival time of each byte(TMR1H) kept next to it, see Serial_readTimed.
+//Costs BUF_SIZE bytes of RAM.
+#define RX_TIMESTAMP    DISABLE
+//Frame end after a silent line(Serial_frameEnded), timed with CCP2 compare
+#define FRAME_DETECT    DISABLE
+//Idle time that ends a frame, in 1/10 character times(35 = 3.5 characters)
+#define FRAME_GAP       35
+
+//Forwarding of received bytes from the ISR(Serial_bridge)
+#define BRIDGE          DISABLE
+//The bridge ends after BRIDGE_ESCAPE_COUNT BRIDGE_ESCAPE bytes in a row
+#define BRIDGE_ESCAPE   '+'
+#define BRIDGE_ESCAPE_COUNT 3
+//Per-byte filter of the bridge(Serial_bridgeFilter), costs 32 bytes of RAM
+#define BRIDGE_FILTER   DISABLE
+
+//Largest accepted baud rate error in 1/1000(25 = 2.5%). Serial_begin fails to
+//compile if _XTAL_FREQ can not generate the requested rate within this error.
+#define BAUD_TOLERANCE  25
+
+#if (BUF_SIZE & (BUF_SIZE - 1)) || (BUF_SIZE > 128)
+#error "BUF_SIZE must be a power of two, 128 at most"
+#endif
+#define BUF_MASK        (BUF_SIZE - 1)
+
+#if (TX_BUF_SIZE & (TX_BUF_SIZE - 1)) || (TX_BUF_SIZE > 128)
+#error "TX_BUF_SIZE must be a power of two, 128 at most"
+#endif
+#define TX_BUF_MASK     (TX_BUF_SIZE - 1)
+
+#if RS485 == ENABLE && FLOW_CONTROL != FLOW_NONE
+#error "Flow control is not available with RS485"
+#endif
+
+#if (LINE_COUNT & (LINE_COUNT - 1))
+#error "LINE_COUNT must be a power of two"
+#endif
+#define LINE_MASK       (LINE_COUNT - 1)
+
+// Snapshot of the link counters(see Serial_getStats)
+typedef struct {
+    unsigned long rx_bytes;         // Bytes read from the receiver
+    unsigned long tx_bytes;         // Bytes moved to the transmitter
+    unsigned int overflows;         // Bytes lost with the incoming buffer full
+    unsigned int overruns;          // OERR events
+    unsigned int framing_errors;    // Bytes with FERR
+    unsigned char rx_peak;          // Highest incoming buffer occupancy
+    unsigned char tx_peak;          // Highest outgoing buffer depth
+#if ISR_TIMING == ENABLE
+    unsigned int isr_min;           // Timer1 ticks per byte in Serial_ReadISR
+    unsigned int isr_max;
+    unsigned long isr_total;        // Ticks of all calls, divide by rx_bytes for the average
+#endif
+#if BRIDGE == ENABLE
+    unsigned long bridge_bytes;     // Bytes forwarded by the bridge
+    unsigned int bridge_max;        // Timer1 ticks from Serial_ReadISR entry to the sink
+    unsigned long bridge_total;     // Ticks of all forwarded bytes, divide by bridge_bytes
+#endif
+} Serial_stats;
+
+// State of a serial port: its circular buffers and the functions of its back end.
+// The counters are free running and masked on access, so (save - read) is the
+// number of bytes in a buffer. rx_save is changed by the receive ISR only and
+// rx_read by the main code only; tx_save by the main code and tx_read by the ISR.
+typedef struct {
+    unsigned char *rx_buffer;
+    unsigned char rx_mask;              // Buffer size - 1
+    volatile unsigned char rx_save;
+    volatile unsigned char rx_read;
+    unsigned char *tx_buffer;
+    unsigned char tx_mask;
+    volatile unsigned char tx_save;
+    volatile unsigned char tx_read;
+    void (*start_tx)(void);             // Called after a byte is queued
+    void (*wait_tx)(void);              // Waits for the last byte to leave
+} Serial_port;
+
+// The hardware port(EUSART) and its incoming buffer, shared with the protocol
+// layers that decode in place(packet.c). Only the main code may change Serial.rx_read.
+extern Serial_port Serial;
+extern unsigned char read_buffer[BUF_SIZE];
+
+/*******************************************************************************
+* BAUD RATE SOLVER                                                             *
+*******************************************************************************/
+// The baud rate is Fosc/(divider*(SPBRGH:SPBRG+1)) where the divider is set by
+// BRGH and BRG16(Asynchronous mode):
+//   BRG16=0 BRGH=0 : 64, 8-bit SPBRG
+//   BRG16=1 BRGH=0 : 16, 16-bit SPBRGH:SPBRG(covers BRG16=0 BRGH=1 too)
+//   BRG16=1 BRGH=1 : 4,  16-bit SPBRGH:SPBRG
+// These macros evaluate every divider with a rounded SPBRG and pick the one
+// closest to the requested rate. With a constant baud everything is folded by
+// the compiler, so no division is left for run time.
+
+// Rounded SPBRGH:SPBRG+1 for a divider
+#define SERIAL_N(baud, div)     (((unsigned long)_XTAL_FREQ + (unsigned long)(div) * (baud) / 2) \
+                                / ((unsigned long)(div) * (baud)))
+// Achieved baud rate for a divider
+#define SERIAL_RATE(baud, div)  ((unsigned long)_XTAL_FREQ / ((unsigned long)(div) * SERIAL_N(baud, div)))
+// Deviation from the requested rate in baud, 0xFFFFFFFF if SPBRG is out of range
+#define SERIAL_DEV(baud, div, max)  ((SERIAL_N(baud, div) == 0 || SERIAL_N(baud, div) > (max)) \
+                                ? 0xFFFFFFFFUL \
+                                : (SERIAL_RATE(baud, div) > (baud) \
+                                    ? SERIAL_RATE(baud, div) - (baud) \
+                                    : (baud) - SERIAL_RATE(baud, div)))
+#define SERIAL_DEV4(baud)       SERIAL_DEV(baud, 4, 65536UL)
+#define SERIAL_DEV16(baud)      SERIAL_DEV(baud, 16, 65536UL)
+#define SERIAL_DEV64(baud)      SERIAL_DEV(baud, 64, 256UL)
+
+// Divider(4, 16 or 64) with the lowest error
+#define SERIAL_DIVIDER(baud)    (SERIAL_DEV4(baud) <= SERIAL_DEV16(baud) \
+                                ? (SERIAL_DEV4(baud) <= SERIAL_DEV64(baud) ? 4 : 64) \
+                                : (SERIAL_DEV16(baud) <= SERIAL_DEV64(baud) ? 16 : 64))
+// SPBRGH:SPBRG value for the selected divider
+#define SERIAL_SPBRG(baud)      ((unsigned int)(SERIAL_N(baud, SERIAL_DIVIDER(baud)) - 1))
+// Achieved baud rate error in 1/1000
+#define SERIAL_BAUD_ERROR(baud) (SERIAL_DEV(baud, SERIAL_DIVIDER(baud), 65536UL) * 1000 / (baud))
+// Fails to compile(negative array size) if the error is above BAUD_TOLERANCE
+#define SERIAL_BAUD_CHECK(baud) sizeof(char[SERIAL_BAUD_ERROR(baud) <= BAUD_TOLERANCE ? 1 : -1])
+
 
 /*******************************************************************************
 * FUNCTION PROTOTYPES                                                          *
@@ -32,31 +203,106 @@ extern char temp10;
 // ISR function to call for Serial Receive Interrupt
 void Serial_ReadISR(void);
 
+// ISR function to call for Serial Transmit Interrupt(only when TXIE is set)
+void Serial_WriteISR(void);
+
+#if RS485 == ENABLE || FLOW_CONTROL != FLOW_NONE
+// ISR function to call for the CCP1 compare interrupt(only when CCP1IE is set).
+// Releases the RS-485 bus once transmission is complete(RS485), or restarts the
+// flow once there is room in the incoming buffer or CTS is back(FLOW_CONTROL).
+void Serial_CompareISR(void);
+#endif
+
+#if FRAME_DETECT == ENABLE
+// ISR function to call for the CCP2 compare interrupt(only when CCP2IE is set).
+// Marks the end of a frame once the line is silent for FRAME_GAP.
+void Serial_GapISR(void);
+
+// Returns true once for each frame: the line has been silent for FRAME_GAP
+// after the last received byte. The frame is in the incoming buffer.
+bit Serial_frameEnded(void);
+#endif
+
 // Number of available data bytes
 unsigned char Serial_available(void);
 
-// Start the Serial port
-void Serial_begin(unsigned long speed);
+// Number of received bytes lost since Serial_begin (buffer full, overrun or framing error)
+unsigned int Serial_dropCount(void);
+
+#if SERIAL_STATS == ENABLE
+// Copies the link counters to stats. Interrupts are held off during the copy,
+// so the snapshot is consistent.
+void Serial_getStats(Serial_stats *stats);
+
+// Clears the link counters
+void Serial_resetStats(void);
+#endif
+
+// Start the Serial port. speed must be a constant, the baud rate registers are
+// solved at compile time. eg:- Serial_begin(115200);
+#define Serial_begin(speed)     Serial_beginBRG(SERIAL_SPBRG(speed) + 0 * SERIAL_BAUD_CHECK(speed), \
+                                                SERIAL_DIVIDER(speed))
+
+// Start the Serial port with a given SPBRGH:SPBRG value and divider(4, 16 or 64)
+void Serial_beginBRG(unsigned int brg, unsigned char divider);
+
+#if MULTIDROP == ENABLE
+// Start the Serial port as a node of a 9-bit multi-drop bus.
+// Only messages sent to address or BROADCAST_ADDRESS reach the incoming buffer.
+#define Serial_beginMultidrop(speed, address) \
+                                Serial_beginMultidropBRG(SERIAL_SPBRG(speed) + 0 * SERIAL_BAUD_CHECK(speed), \
+                                                         SERIAL_DIVIDER(speed), address)
+void Serial_beginMultidropBRG(unsigned int brg, unsigned char divider, unsigned char address);
+
+// Sends a message to a node of the multi-drop bus: the address byte with the
+// 9th bit set, then length bytes of buf.
+void Serial_sendTo(unsigned char address, const unsigned char *buf, unsigned char length);
+#endif
+
+// Start the Serial port at the rate of the host. Waits up to timeout milliseconds
+// for the host to send the sync character 0x55('U') and measures it with the
+// Auto-Baud Detect hardware. Returns the detected baud rate, or 0 if nothing was
+// received in time(call Serial_begin then to fall back to a fixed rate).
+unsigned long Serial_beginAuto(unsigned int timeout);
 
 // Stop Serial port(Pins will be available for generic use)
 void Serial_end(void);
 
-// Read data from serial buffer until the target string of given length is found.
+// Read data from serial buffer until the target string is found.
 // The function returns true if target string is found, false if it times out.
-bit Serial_find(unsigned char str);
+// Only the first FIND_MAX_LEN characters of the target are matched.
+bit Serial_find(const unsigned char *target);
 
 
-// Reads data from the serial buffer until a target string of given length or
-// terminator string is found. The function returns true if the target
-// string is found, false if it times out.
-bit Serial_findUntil(unsigned char str, unsigned char terminator);
+// Reads data from the serial buffer until a target string or terminator
+// string is found. The function returns true if the target string is found,
+// false if the terminator is found or it times out. terminator may be 0.
+bit Serial_findUntil(const unsigned char *target, const unsigned char *terminator);
 
-//Waits for the transmission of outgoing serial data to complete.
+//Waits for the transmission of outgoing serial data to complete. Returns when
+//the outgoing buffer is empty and the last stop bit has left the shift register
+//(with RS485, when the bus has been released).
 void Serial_flush(void);
 
 //Prints data to the serial port. Supports Strings only.
 void Serial_print(unsigned char *str);
 
+// Prints a string from program memory(const) without copying it to RAM first.
+void Serial_printConst(const unsigned char *str);
+
+// Prints an integer in base 2, 8, 10 or 16(other bases print in 10). Negative
+// numbers get a '-' in base 10 only, like Arduino's Serial.print(value, base).
+void Serial_printInt(long value, unsigned char base);
+
+// Prints an unsigned number in hexadecimal, with leading zeros up to digits.
+void Serial_printHex(unsigned long value, unsigned char digits);
+
+// Prints value/10^decimals as a fixed point number. eg:- (1234, 2) prints 12.34
+void Serial_printFixed(long value, unsigned char decimals);
+
+// Prints formatted text. Supports %c %s %d %i %u %x %X %ld %li %lu %lx %lX and %%.
+void Serial_printf(const char *format, ...);
+
 // Prints data to the serial port as human-readable ASCII text followed by a carriage
 // return character (ASCII 13, or '\r') and a newline character (ASCII 10, or '\n').
 // This command takes the same forms as Serial_print().
@@ -66,6 +312,13 @@ void Serial_println(unsigned char *str);
 // Supports byte only.
 unsigned char Serial_read(void);
 
+#if RX_TIMESTAMP == ENABLE
+// Reads a byte like Serial_read and stores its arrival time in time, in units of
+// 256 Timer1 ticks(the TMR1H value). It wraps every 65536 ticks, so only the
+// difference between close bytes is meaningful.
+unsigned char Serial_readTimed(unsigned char *time);
+#endif
+
 // Reads characters from the serial port into a buffer. The function terminates
 // if the determined length has been read, or it times out.
 // Returns the number of characters placed in the buffer. A 0 means no valid data was found.
@@ -73,12 +326,96 @@ unsigned char Serial_readBytes(unsigned char buffer[], unsigned char length);
 
 // Reads characters from the serial buffer into an array. The function terminates
 // if the terminator character is detected, the determined length has been read, or it times out.
+// The terminator is removed from the buffer but not stored.
 // Returns the number of characters placed in the buffer. A 0 means no valid data was found.
 unsigned char Serial_readBytesUntil(unsigned char str, unsigned char buffer[], unsigned char length);
 
+// Same as Serial_readBytesUntil, but stores a string: buffer is ended with a 0,
+// so at most length - 1 characters are read. Returns the string length.
+unsigned char Serial_readStringUntil(unsigned char terminator, unsigned char buffer[], unsigned char length);
+
+// Returns the next byte without removing it from the buffer, or -1 if there is none.
+int Serial_peek(void);
+
+// Returns the next integer. Skips everything before the first digit or minus sign
+// and stops at the first byte that is not a digit, which stays in the buffer.
+// Returns 0 if no digit comes within the time-out.
+long Serial_parseInt(void);
+
+// Same as Serial_parseInt, but also takes one decimal point(like parseFloat).
+// Returns the number scaled by 10^decimals, eg:- "-3.14159" with 2 decimals
+// gives -314. Further digits are read and dropped.
+long Serial_parseFixed(unsigned char decimals);
+
+// Sets the maximum milliseconds to wait for the next byte in the read functions.
+// Defaults to TIMEOUT. Measured with Timer1.
+void Serial_setTimeout(unsigned int timeout);
+
+#if LINE_MODE == ENABLE
+// Number of complete lines waiting
+unsigned char Serial_lineAvailable(void);
+
+// Copies the next complete line into buffer without the line ending and adds a
+// 0 terminator. Characters that do not fit in length-1 are discarded. A line
+// longer than the incoming buffer comes in parts of BUF_SIZE characters.
+// Lines partly taken by the other read functions are skipped; do not mix them.
+// Returns the number of characters placed in the buffer.
+unsigned char Serial_readLine(unsigned char buffer[], unsigned char length);
+#endif
+
 // Writes binary data to the serial port. Supports single byte only.
+// The byte is queued in the outgoing buffer; waits only if the buffer is full.
 void Serial_write(unsigned char str);
 
+// Queues a byte for transmission without waiting.
+// Returns true if the byte is queued, false if the outgoing buffer is full.
+bit Serial_tryWrite(unsigned char str);
+
+// Number of bytes that can be written without waiting
+unsigned char Serial_availableForWrite(void);
+
+#if BRIDGE == ENABLE
+// Forwards every received byte from Serial_ReadISR to sink(&Serial for loopback,
+// &SoftSerial for the software port), or to hook when it is not 0. hook runs in
+// the interrupt. The main code must not write to the sink while bridging.
+// BRIDGE_ESCAPE_COUNT BRIDGE_ESCAPE bytes in a row(forwarded too) end the bridge
+// to a sink, later bytes go to the incoming buffer again. A hook gets binary data
+// unchanged and calls Serial_bridgeEnd itself.
+void Serial_bridge(Serial_port *sink, void (*hook)(unsigned char x));
+
+// Ends the bridge
+void Serial_bridgeEnd(void);
+
+// Returns true while the bridge forwards the received bytes
+bit Serial_bridgeActive(void);
+
+#if BRIDGE_FILTER == ENABLE
+// Drops x in the bridge(pass = FALSE) or forwards it again(pass = TRUE)
+void Serial_bridgeFilter(unsigned char x, unsigned char pass);
+#endif
+#endif
+
+/*******************************************************************************
+* FUNCTIONS FOR ANY PORT                                                       *
+*******************************************************************************/
+// The same functions for any port, eg:- SerialPort_print(&SoftSerial, "GPS");
+// With &Serial they turn into the Serial_ functions at compile time, so the
+// hardware port costs no extra cycles. port must not have side effects.
+#define SerialPort_available(port)      ((port) == &Serial ? Serial_available() : Port_available(port))
+#define SerialPort_read(port)           ((port) == &Serial ? Serial_read() : Port_read(port))
+#define SerialPort_tryWrite(port, x)    ((port) == &Serial ? Serial_tryWrite(x) : Port_tryWrite(port, x))
+#define SerialPort_write(port, x)       ((port) == &Serial ? Serial_write(x) : Port_write(port, x))
+#define SerialPort_print(port, str)     ((port) == &Serial ? Serial_print(str) : Port_print(port, str))
+#define SerialPort_println(port, str)   ((port) == &Serial ? Serial_println(str) : Port_println(port, str))
+#define SerialPort_flush(port)          ((port) == &Serial ? Serial_flush() : Port_flush(port))
+
+unsigned char Port_available(Serial_port *port);
+unsigned char Port_read(Serial_port *port);
+bit Port_tryWrite(Serial_port *port, unsigned char x);
+void Port_write(Serial_port *port, unsigned char x);
+void Port_print(Serial_port *port, unsigned char *str);
+void Port_println(Serial_port *port, unsigned char *str);
+void Port_flush(Serial_port *port);
 
 
 #endif	/* SERIAL_H */
\ No newline at end of file
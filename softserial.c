@@ -0,0 +1,141 @@
+/*
+ * File:   softserial.c
+ *
+ * Created on 17 October 2026
+ */
+
+// include the header for software serial library:
+#include "softserial.h"
+
+
+/*******************************************************************************
+* This file provides a second Serial port(Software, Timer2 interrupt driven)
+*******************************************************************************/
+
+/*
+ Timer2 interrupts three times per bit. The receiver waits for the falling edge
+ of the start bit, then samples four ticks later(the middle of the first data
+ bit) and every three ticks after that. The transmitter changes the pin every
+ three ticks. Both directions run at the same time, 8 data bits, no parity,
+ 1 stop bit.
+
+ The circuit:
+ * Transmit pin define as SOFT_TX in softserial.h
+ * Receive pin define as SOFT_RX in softserial.h
+ */
+
+unsigned char soft_read_buffer[SOFT_BUF_SIZE];
+unsigned char soft_write_buffer[SOFT_TX_BUF_SIZE];
+
+static void SoftSerial_startTx(void);
+static void SoftSerial_waitTx(void);
+
+Serial_port SoftSerial = {
+    soft_read_buffer, SOFT_BUF_SIZE - 1, 0, 0,
+    soft_write_buffer, SOFT_TX_BUF_SIZE - 1, 0, 0,
+    SoftSerial_startTx, SoftSerial_waitTx
+};
+
+static unsigned char soft_rx_bits = 0;      // Samples left: 8 data bits and the stop bit
+static unsigned char soft_rx_wait;          // Ticks to the next sample
+static unsigned char soft_rx_byte;
+static volatile unsigned char soft_tx_bits = 0; // 10 start bit, 9..2 data bits, 1 stop bit, 0 idle
+static unsigned char soft_tx_wait;          // Ticks to the next bit
+static unsigned char soft_tx_byte;
+
+// Start the software serial port with a given PR2 value and Timer2 prescaler(1, 4 or 16)
+// SoftSerial_begin(speed) calculates both at compile time.
+void SoftSerial_beginPR2(unsigned char pr2, unsigned char prescale)
+{
+    SOFT_TX = 1;            // Idle line is high
+    SOFT_TX_dir = OUTPUT;
+    SOFT_RX_dir = INPUT;
+
+    SoftSerial.rx_save = 0;
+    SoftSerial.rx_read = 0;
+    SoftSerial.tx_save = 0;
+    SoftSerial.tx_read = 0;
+    soft_rx_bits = 0;
+    soft_tx_bits = 0;
+
+//    T2CON: Postscaler 1:1, Timer2 on, Prescaler 1, 4 or 16
+    TMR2 = 0;
+    PR2 = pr2;
+    if (prescale == 1)
+        T2CON = 0b00000100;
+    else if (prescale == 4)
+        T2CON = 0b00000101;
+    else
+        T2CON = 0b00000110;
+
+    TMR2IF = 0;
+    TMR2IE = 1;
+    PEIE = 1;
+    GIE = 1;
+}
+
+// The ISR picks up queued bytes by itself
+static void SoftSerial_startTx(void)
+{
+}
+
+// Waits for the stop bit of the last byte
+static void SoftSerial_waitTx(void)
+{
+    while (soft_tx_bits)
+        NOP();
+}
+
+// ISR function to call for the Timer2 interrupt(TMR2IF)
+void SoftSerial_ISR(void)
+{
+    TMR2IF = 0;
+
+    // Receive
+    if (soft_rx_bits == 0)
+    {
+        if (!SOFT_RX)
+        {
+            soft_rx_bits = 9;       // Start bit
+            soft_rx_wait = 4;
+        }
+    }
+    else if (--soft_rx_wait == 0)
+    {
+        soft_rx_wait = 3;
+        if (--soft_rx_bits)
+        {
+            soft_rx_byte >>= 1;     // Data bits come LSB first
+            if (SOFT_RX)
+                soft_rx_byte |= 0x80;
+        }
+        else if (SOFT_RX            // A low stop bit is a framing error
+                 && (unsigned char)(SoftSerial.rx_save - SoftSerial.rx_read) != SOFT_BUF_SIZE)
+        {
+            soft_read_buffer[SoftSerial.rx_save & (SOFT_BUF_SIZE - 1)] = soft_rx_byte;
+            SoftSerial.rx_save++;
+        }
+    }
+
+    // Transmit
+    if (soft_tx_bits && --soft_tx_wait == 0)
+    {
+        soft_tx_wait = 3;
+        soft_tx_bits--;
+        if (soft_tx_bits > 1)
+        {
+            SOFT_TX = soft_tx_byte & 1;
+            soft_tx_byte >>= 1;
+        }
+        else if (soft_tx_bits == 1)
+            SOFT_TX = 1;            // Stop bit
+    }
+    if (soft_tx_bits == 0 && SoftSerial.tx_read != SoftSerial.tx_save)
+    {
+        soft_tx_byte = soft_write_buffer[SoftSerial.tx_read & (SOFT_TX_BUF_SIZE - 1)];
+        SoftSerial.tx_read++;
+        SOFT_TX = 0;                // Start bit
+        soft_tx_bits = 10;
+        soft_tx_wait = 3;
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * File:   softserial.h
+ *
+ * Created on 17 October 2026
+ */
+
+#ifndef SOFTSERIAL_H
+#define	SOFTSERIAL_H
+
+#include "serial.h"
+
+// Pin defines for the software serial port
+#define SOFT_TX             RD0
+#define SOFT_RX             RD1
+
+// TRIS Setting for the pins
+#define SOFT_TX_dir         TRISD0
+#define SOFT_RX_dir         TRISD1
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+//Defined size for incoming and outgoing buffers. Must be a power of two, 128 at most.
+#define SOFT_BUF_SIZE       32
+#define SOFT_TX_BUF_SIZE    16
+
+//Fewest instruction cycles between Timer2 interrupts. SoftSerial_begin fails to
+//compile for faster rates. Each interrupt costs about 40 cycles with the line
+//idle and up to about 110 with a bit received and sent in the same tick(context
+//save and restore, the dispatch of main.c and SoftSerial_ISR). That is 20% to
+//55% of the CPU at this limit, 15% to 40% at 2400 baud with 8MHz(280 cycles).
+//9600 baud at 8MHz gives only 69 cycles and is refused.
+#define SOFT_MIN_CYCLES     200
+
+#if (SOFT_BUF_SIZE & (SOFT_BUF_SIZE - 1)) || (SOFT_BUF_SIZE > 128)
+#error "SOFT_BUF_SIZE must be a power of two, 128 at most"
+#endif
+#if (SOFT_TX_BUF_SIZE & (SOFT_TX_BUF_SIZE - 1)) || (SOFT_TX_BUF_SIZE > 128)
+#error "SOFT_TX_BUF_SIZE must be a power of two, 128 at most"
+#endif
+
+// Timer2 interrupts three times per bit. Instruction cycles per interrupt,
+// the Timer2 prescaler(1, 4 or 16) and PR2, solved at compile time.
+#define SOFT_CYCLES(baud)   (((unsigned long)_XTAL_FREQ / 4 + 3UL * (baud) / 2) / (3UL * (baud)))
+#define SOFT_PRESCALE(baud) (SOFT_CYCLES(baud) <= 256 ? 1 : (SOFT_CYCLES(baud) <= 1024 ? 4 : 16))
+#define SOFT_PR2(baud)      ((unsigned char)((SOFT_CYCLES(baud) + SOFT_PRESCALE(baud) / 2) \
+                                / SOFT_PRESCALE(baud) - 1))
+// Fails to compile(negative array size) if Timer2 can not run at the rate
+#define SOFT_CHECK(baud)    sizeof(char[SOFT_CYCLES(baud) >= SOFT_MIN_CYCLES \
+                                && SOFT_CYCLES(baud) <= 4096 ? 1 : -1])
+
+
+/*******************************************************************************
+* FUNCTION PROTOTYPES                                                          *
+*******************************************************************************/
+// The software serial port. Use it with the SerialPort_ functions of serial.h,
+// eg:- SerialPort_read(&SoftSerial);
+extern Serial_port SoftSerial;
+
+// ISR function to call for the Timer2 interrupt(TMR2IF)
+void SoftSerial_ISR(void);
+
+// Start the software serial port. speed must be a constant. eg:- SoftSerial_begin(2400);
+// There is no SerialPort_begin: each port checks its own rates at compile time.
+#define SoftSerial_begin(speed) SoftSerial_beginPR2(SOFT_PR2(speed) + 0 * SOFT_CHECK(speed), \
+                                                    SOFT_PRESCALE(speed))
+
+// Start the software serial port with a given PR2 value and Timer2 prescaler(1, 4 or 16)
+void SoftSerial_beginPR2(unsigned char pr2, unsigned char prescale);
+
+#endif	/* SOFTSERIAL_H */
@@ -55,3 +55,22 @@ void System_Setup (void)
     ANSELH = 0x00;
 }
 
+void Timer_begin (void)
+{
+//    Timer1 free running from the instruction clock, Prescaler 1:1, no interrupt.
+//    Writing T1CON does not clear the count, so this can be called more than once.
+    T1CON = 0b00000001;
+}
+
+unsigned int Timer_ticks (void)
+{
+    unsigned char upper, lower;
+//    Re-read if TMR1L rolled over into TMR1H between the two reads
+    do
+    {
+        upper = TMR1H;
+        lower = TMR1L;
+    } while (upper != TMR1H);
+    return ((unsigned int)upper << 8) | lower;
+}
+
@@ -10,7 +10,10 @@
 
 #include <htc.h>
 
+// Can be overridden from the compiler command line(-D_XTAL_FREQ=...)
+#ifndef _XTAL_FREQ
 #define _XTAL_FREQ 8000000
+#endif
 
 // Specific definitions for our custom framework
 #define ON                  1
@@ -47,9 +50,15 @@
 #define LF          10
 #define SERIAL_BUFFER_SIZE          1
 
+// Timer1 ticks at the instruction clock(Fosc/4)
+#define TICKS_PER_MS        (_XTAL_FREQ/4000)
+
 // Function prototypes
 void Osc_Setup (unsigned char); // INTERNAL/EXTERNAL Oscillator
 void System_Setup (void);
+void Timer_begin (void);        // Start Timer1 as a free running time base
+unsigned int Timer_ticks (void);    // Read Timer1 (wraps every 65536 ticks, so
+                                    // take differences as unsigned short)
 
 #endif	/* SYSTEM_H */
 
@@ -0,0 +1,201 @@
+/*
+ * File:   transport.c
+ *
+ * Created on 17 October 2026
+ */
+
+// include the header for transport library:
+#include "transport.h"
+
+
+/*******************************************************************************
+* This file provides a reliable, windowed frame transport over the Serial port
+*******************************************************************************/
+
+/*
+ A frame is a control byte, the payload and the CRC-16 of both(low byte first),
+ byte stuffed and ended by TRANSPORT_FLAG:
+
+    control = DATA(bit 7) | sequence(bits 6-4) | ack(bits 2-0)
+
+ ack is the next sequence number expected from the other side, so it
+ acknowledges every frame before it(cumulative ACK) and rides along with data
+ for free. A frame without DATA is a bare ACK. Sequence numbers count modulo 8.
+
+ Up to TRANSPORT_WINDOW frames are sent before waiting for an ACK. The
+ receiver takes frames in order only and drops the rest; when no ACK comes
+ for TRANSPORT_TIMEOUT, all unacknowledged frames are sent again(Go-Back-N).
+ This needs no receive buffering, which suits the RAM of the PIC.
+ */
+
+#define DATA_FRAME          0x80
+
+static unsigned char tx_frame[TRANSPORT_WINDOW][TRANSPORT_SIZE];   // Kept until acknowledged
+static unsigned char tx_length[TRANSPORT_WINDOW];
+static unsigned char tx_base;           // Oldest unacknowledged sequence number
+static unsigned char tx_next;           // Sequence number of the next new frame
+static unsigned char rx_expected;       // Next sequence number to accept
+
+static unsigned char rx_frame[TRANSPORT_SIZE + 3];  // Control, payload and CRC
+static unsigned char rx_length;         // Bytes in rx_frame, 0xFF after an overflow
+static bit rx_escape;                   // Last byte was TRANSPORT_ESC
+
+static unsigned int timer_last;         // Timer1 at the last Transport_poll
+static unsigned long timer_ticks;       // Ticks since the window was last sent
+static unsigned int transport_retries;
+
+static void Transport_put(unsigned char x);
+static void Transport_frame(unsigned char control, const unsigned char *data, unsigned char length);
+
+// Starts the transport on the Serial port
+void Transport_begin(void)
+{
+    tx_base = 0;
+    tx_next = 0;
+    rx_expected = 0;
+    rx_length = 0;
+    rx_escape = FALSE;
+    timer_last = Timer_ticks();
+    timer_ticks = 0;
+    transport_retries = 0;
+}
+
+// Sends one byte, escaped if it looks like a flag or an escape
+static void Transport_put(unsigned char x)
+{
+    if (x == TRANSPORT_FLAG || x == TRANSPORT_ESC)
+    {
+        Serial_write(TRANSPORT_ESC);
+        x ^= 0x20;
+    }
+    Serial_write(x);
+}
+
+// Sends a frame with the current ACK
+static void Transport_frame(unsigned char control, const unsigned char *data, unsigned char length)
+{
+    unsigned int crc;
+    unsigned char i;
+
+    control |= rx_expected;
+    crc = CRC16_update(CRC16_INIT, control);
+    Serial_write(TRANSPORT_FLAG);   // Ends any noise before the frame
+    Transport_put(control);
+    for (i = 0; i < length; i++)
+    {
+        crc = CRC16_update(crc, data[i]);
+        Transport_put(data[i]);
+    }
+    Transport_put(crc & 0xff);
+    Transport_put(crc >> 8);
+    Serial_write(TRANSPORT_FLAG);
+}
+
+// Sends data as the next frame of the window
+bit Transport_send(const unsigned char *data, unsigned char length)
+{
+    unsigned char slot = tx_next & (TRANSPORT_WINDOW - 1);
+    unsigned char i;
+
+    if (Transport_pending() == TRANSPORT_WINDOW || length > TRANSPORT_SIZE)
+        return FALSE;
+    for (i = 0; i < length; i++)
+        tx_frame[slot][i] = data[i];
+    tx_length[slot] = length;
+    if (tx_base == tx_next)
+        timer_ticks = 0;    // The timer runs for the oldest frame
+    Transport_frame(DATA_FRAME | (tx_next << 4), tx_frame[slot], length);
+    tx_next = (tx_next + 1) & 7;
+    return TRUE;
+}
+
+// Runs the protocol. Returns the payload length of a new frame in order.
+unsigned char Transport_poll(void)
+{
+    unsigned int now = Timer_ticks();
+    unsigned char inByte;
+    unsigned char control;
+    unsigned char seq;
+
+    // Go-Back-N: send the whole window again when the oldest frame times out
+    if (tx_base != tx_next)
+        timer_ticks += (unsigned short)(now - timer_last);
+    timer_last = now;
+    if (timer_ticks >= (unsigned long)TRANSPORT_TIMEOUT * TICKS_PER_MS)
+    {
+        timer_ticks = 0;
+        transport_retries++;
+        for (seq = tx_base; seq != tx_next; seq = (seq + 1) & 7)
+            Transport_frame(DATA_FRAME | (seq << 4), tx_frame[seq & (TRANSPORT_WINDOW - 1)],
+                            tx_length[seq & (TRANSPORT_WINDOW - 1)]);
+    }
+
+    while (Serial_available())
+    {
+        inByte = Serial_read();
+        if (inByte == TRANSPORT_ESC)
+        {
+            rx_escape = TRUE;
+            continue;
+        }
+        if (inByte != TRANSPORT_FLAG)
+        {
+            if (rx_escape)
+                inByte ^= 0x20;
+            rx_escape = FALSE;
+            if (rx_length < sizeof(rx_frame))
+                rx_frame[rx_length++] = inByte;
+            else
+                rx_length = 0xFF;   // Too long, drop it at the next flag
+            continue;
+        }
+
+        // End of a frame: check it, then start the next one
+        control = rx_length;
+        rx_length = 0;
+        rx_escape = FALSE;
+        if (control < 3 || control == 0xFF || CRC16_block(rx_frame, control) != CRC16_OK)
+            continue;       // Empty(two flags in a row), overflowed or damaged
+        inByte = control - 3;       // Payload length
+        control = rx_frame[0];
+
+        // Cumulative ACK: frames up to ack - 1 arrived
+        seq = control & 7;
+        if (((seq - tx_base) & 7) <= ((tx_next - tx_base) & 7) && seq != tx_base)
+        {
+            tx_base = seq;
+            timer_ticks = 0;
+        }
+
+        if (control & DATA_FRAME)
+        {
+            seq = (control >> 4) & 7;
+            if (seq == rx_expected)
+            {
+                rx_expected = (rx_expected + 1) & 7;
+                Transport_frame(0, 0, 0);
+                return inByte;
+            }
+            Transport_frame(0, 0, 0);   // Repeat the ACK for a lost or duplicate frame
+        }
+    }
+    return 0;
+}
+
+// Payload of the frame returned by Transport_poll
+unsigned char *Transport_data(void)
+{
+    return rx_frame + 1;
+}
+
+// Number of frames sent and not acknowledged yet
+unsigned char Transport_pending(void)
+{
+    return (tx_next - tx_base) & 7;
+}
+
+// Number of timeouts that sent the window again
+unsigned int Transport_retries(void)
+{
+    return transport_retries;
+}
@@ -0,0 +1,57 @@
+/*
+ * File:   transport.h
+ *
+ * Created on 17 October 2026
+ */
+
+#ifndef TRANSPORT_H
+#define	TRANSPORT_H
+
+#include "serial.h"
+#include "crc16.h"
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+//Largest payload of one frame(bytes)
+#define TRANSPORT_SIZE      16
+//Frames sent before waiting for an ACK. Must be 2 or 4; the frames are kept for
+//retransmission, so this costs TRANSPORT_WINDOW * TRANSPORT_SIZE bytes of RAM.
+#define TRANSPORT_WINDOW    4
+//Time without an ACK before the frames are sent again(ms)
+#define TRANSPORT_TIMEOUT   100
+
+#if TRANSPORT_WINDOW != 2 && TRANSPORT_WINDOW != 4
+#error "TRANSPORT_WINDOW must be 2 or 4"
+#endif
+
+//Frame delimiter and escape byte(HDLC). An escaped byte is sent XOR 0x20.
+#define TRANSPORT_FLAG      0x7E
+#define TRANSPORT_ESC       0x7D
+
+
+/*******************************************************************************
+* FUNCTION PROTOTYPES                                                          *
+*******************************************************************************/
+// Starts the transport on the Serial port(call Serial_begin first)
+void Transport_begin(void);
+
+// Sends data as the next frame of the window. Returns false if the window is
+// full; Transport_poll makes room as ACKs arrive.
+bit Transport_send(const unsigned char *data, unsigned char length);
+
+// Runs the protocol: decodes the incoming buffer, answers with ACKs and sends
+// the window again after TRANSPORT_TIMEOUT. Call it at least every 30ms.
+// Returns the payload length of a new frame in order, or 0 if there is none.
+unsigned char Transport_poll(void);
+
+// Payload of the frame returned by Transport_poll, valid until the next call
+unsigned char *Transport_data(void);
+
+// Number of frames sent and not acknowledged yet
+unsigned char Transport_pending(void);
+
+// Number of timeouts that sent the window again
+unsigned int Transport_retries(void);
+
+#endif	/* TRANSPORT_H */